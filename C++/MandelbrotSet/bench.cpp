@@ -0,0 +1,363 @@
+// Headless benchmarks for the escape-time kernels (no SDL needed)
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "fractal.hpp"
+#include "precision.hpp"
+#include "tile_scheduler.hpp"
+
+// Benchmark frame size and work per pixel
+const int BENCH_WIDTH = 400;
+const int BENCH_HEIGHT = 300;
+const int BENCH_ITERATIONS = 500;
+const int BENCH_REPEATS = 3;
+
+struct BenchCase {
+    const char* name;
+    FractalParams params;
+};
+
+static FractalParams makeParams(FormulaKind formula, int power, bool julia) {
+    FractalParams params;
+    params.formula = formula;
+    params.power = power;
+    params.julia = julia;
+    return params;
+}
+
+// Best-of-N wall time of rendering a whole frame with the given kernel
+static double timeFrame(RowKernel kernel, const Viewport& view, const FractalParams& params,
+                        std::vector<int>& out) {
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPEATS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        for (int y = 0; y < view.height; ++y) {
+            kernel(view, params, y, 0, view.width, BENCH_ITERATIONS, &out[y * view.width]);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+static long long sumIterations(const std::vector<int>& buffer) {
+    long long total = 0;
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        total += buffer[i];
+    }
+    return total;
+}
+
+// Compare every compiled specialization against the runtime-dispatched loop:
+// first one pixel at a time like the dynamic loop, so only the removed
+// branches count, then with the lanes on top
+static void benchFormulas() {
+    const BenchCase cases[] = {
+        { "mandelbrot",    makeParams(FormulaKind::Multibrot, 2, false) },
+        { "multibrot-3",   makeParams(FormulaKind::Multibrot, 3, false) },
+        { "multibrot-5",   makeParams(FormulaKind::Multibrot, 5, false) },
+        { "multibrot-8",   makeParams(FormulaKind::Multibrot, 8, false) },
+        { "burning-ship",  makeParams(FormulaKind::BurningShip, 2, false) },
+        { "tricorn",       makeParams(FormulaKind::Tricorn, 2, false) },
+        { "julia-2",       makeParams(FormulaKind::Multibrot, 2, true) },
+        { "julia-ship",    makeParams(FormulaKind::BurningShip, 2, true) },
+    };
+
+    Viewport view(BENCH_WIDTH, BENCH_HEIGHT);
+    std::vector<int> dynamic(BENCH_WIDTH * BENCH_HEIGHT);
+    std::vector<int> scalar(BENCH_WIDTH * BENCH_HEIGHT);
+    std::vector<int> lanes(BENCH_WIDTH * BENCH_HEIGHT);
+
+    std::printf("%-14s %11s %11s %8s %11s %8s %s\n", "formula", "dynamic ms", "scalar ms", "special",
+                "lanes ms", "lanes", "match");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const BenchCase& c = cases[i];
+        view.centerReal = c.params.julia ? 0.0 : -0.5;
+
+        double dynamicTime = timeFrame(&renderRowSpanDynamic, view, c.params, dynamic);
+        double scalarTime = timeFrame(selectScalarRowKernel<double>(c.params), view, c.params, scalar);
+        double lanesTime = timeFrame(selectRowKernel<double>(c.params), view, c.params, lanes);
+        bool match = sumIterations(dynamic) == sumIterations(scalar) &&
+                     sumIterations(scalar) == sumIterations(lanes);
+
+        std::printf("%-14s %11.2f %11.2f %7.2fx %11.2f %7.2fx %s\n", c.name,
+                    dynamicTime * 1000.0, scalarTime * 1000.0, dynamicTime / scalarTime,
+                    lanesTime * 1000.0, scalarTime / lanesTime, match ? "yes" : "NO");
+    }
+}
+
+// Viewports where escape times vary wildly between neighbouring pixels
+struct NamedView {
+    const char* name;
+    double centerReal;
+    double centerImag;
+    double pixelSize;
+};
+
+// Lane utilization of the lockstep kernel: each group of KERNEL_LANES pixels
+// runs until its slowest member finishes
+static LaneStats lockstepStats(const std::vector<int>& buffer, int width) {
+    LaneStats stats;
+    for (size_t row = 0; row < buffer.size(); row += width) {
+        int x = 0;
+        for (; x + KERNEL_LANES <= width; x += KERNEL_LANES) {
+            int slowest = 0;
+            for (int k = 0; k < KERNEL_LANES; ++k) {
+                int count = buffer[row + x + k];
+                stats.usefulIterations += count;
+                slowest = count > slowest ? count : slowest;
+            }
+            stats.laneSlots += static_cast<long long>(slowest) * KERNEL_LANES;
+        }
+        for (; x < width; ++x) {
+            stats.usefulIterations += buffer[row + x];
+            stats.laneSlots += buffer[row + x];
+        }
+    }
+    return stats;
+}
+
+// Compare lane utilization and speed of lockstep groups against lane refill
+static void benchLaneRefill() {
+    const NamedView views[] = {
+        { "full-set",        -0.5,        0.0,        3.0 / BENCH_HEIGHT },
+        { "seahorse-valley", -0.743643,   0.131825,   1e-5 },
+        { "elephant-valley",  0.2925,     0.0165,     2e-5 },
+        { "spiral-boundary", -0.7746806, -0.1374168, 1e-6 },
+    };
+
+    FractalParams params;
+    RowKernel lockstep = selectRowKernel<double>(params);
+    RectKernel queued = selectRectKernel<double>(params);
+    std::vector<int> lockstepOut(BENCH_WIDTH * BENCH_HEIGHT);
+    std::vector<int> queuedOut(BENCH_WIDTH * BENCH_HEIGHT);
+
+    std::printf("\n%-16s %10s %10s %10s %10s %s\n",
+                "viewport", "lock util", "refill util", "lock ms", "refill ms", "match");
+    for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); ++i) {
+        Viewport view(BENCH_WIDTH, BENCH_HEIGHT);
+        view.centerReal = views[i].centerReal;
+        view.centerImag = views[i].centerImag;
+        view.pixelSize = views[i].pixelSize;
+
+        double lockTime = timeFrame(lockstep, view, params, lockstepOut);
+
+        LaneStats refill;
+        double refillTime = 1e30;
+        for (int r = 0; r < BENCH_REPEATS; ++r) {
+            refill = LaneStats();
+            auto start = std::chrono::steady_clock::now();
+            queued(view, params, 0, 0, view.width, view.height, BENCH_ITERATIONS,
+                   queuedOut.data(), view.width, &refill);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() < refillTime) {
+                refillTime = elapsed.count();
+            }
+        }
+
+        LaneStats lock = lockstepStats(lockstepOut, view.width);
+        std::printf("%-16s %9.1f%% %9.1f%% %10.2f %10.2f %s\n", views[i].name,
+                    lock.utilization() * 100.0, refill.utilization() * 100.0,
+                    lockTime * 1000.0, refillTime * 1000.0,
+                    lockstepOut == queuedOut ? "yes" : "NO");
+    }
+}
+
+// Time one full frame through a prepared FrameKernel
+static double timeFrameKernel(const FrameKernel& kernel, std::vector<int>& out) {
+    const Viewport& view = kernel.getViewport();
+    double best = 1e30;
+    for (int r = 0; r < BENCH_REPEATS; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        kernel.renderRect(0, 0, view.width, view.height, out.data(), view.width, nullptr);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+// Walk a zoom path, show which rung the ladder picks at every depth, what
+// each rung costs there, and whether the pick survives validation
+static void benchPrecisionLadder() {
+    FractalParams params;
+    std::vector<int> out(BENCH_WIDTH * BENCH_HEIGHT);
+    FrameKernel kernel;
+
+    std::printf("\n%-10s %-14s %10s %10s %10s %10s %10s %s\n", "pixel", "selected",
+                "float ms", "double ms", "fixed ms", "perturb ms", "dd ms", "validation");
+    for (double pixelSize = 3.0 / BENCH_HEIGHT; pixelSize > 1e-20; pixelSize *= 1e-3) {
+        Viewport view(BENCH_WIDTH, BENCH_HEIGHT);
+        view.centerReal = -0.743643887037151;
+        view.centerImag = 0.131825904205330;
+        view.pixelSize = pixelSize;
+        Precision selected = choosePrecision(view, params);
+
+        double times[PRECISION_COUNT];
+        for (int p = 0; p < PRECISION_COUNT; ++p) {
+            kernel.prepare(view, params, BENCH_ITERATIONS, static_cast<Precision>(p));
+            times[p] = timeFrameKernel(kernel, out);
+        }
+
+        ValidationResult check = validatePrecision(view, params, BENCH_ITERATIONS, selected);
+        std::printf("%-10.1e %-14s %10.2f %10.2f %10.2f %10.2f %10.2f %.2f%% vs %s%s\n", pixelSize,
+                    precisionName(selected),
+                    times[static_cast<int>(Precision::Float)] * 1000.0,
+                    times[static_cast<int>(Precision::Double)] * 1000.0,
+                    times[static_cast<int>(Precision::FixedPoint)] * 1000.0,
+                    times[static_cast<int>(Precision::Perturbation)] * 1000.0,
+                    times[static_cast<int>(Precision::DoubleDouble)] * 1000.0,
+                    check.mismatchedFraction * 100.0, precisionName(check.reference),
+                    check.visiblyDifferent ? " FLAGGED" : "");
+    }
+}
+
+// FNV-1a over an iteration buffer, for comparing renders between hosts
+static unsigned long long checksum(const std::vector<int>& buffer) {
+    unsigned long long hash = 14695981039346656037ull;
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        unsigned int value = static_cast<unsigned int>(buffer[i]);
+        for (int b = 0; b < 4; ++b) {
+            hash ^= (value >> (8 * b)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// Throughput of the deterministic fixed-point kernel against the floating
+// point kernels, plus a checksum of its output to diff across hosts
+static void benchFixedPoint() {
+    const NamedView views[] = {
+        { "full-set",        -0.5,        0.0,        3.0 / BENCH_HEIGHT },
+        { "seahorse-valley", -0.743643,   0.131825,   1e-5 },
+        { "elephant-valley",  0.2925,     0.0165,     2e-5 },
+        { "deep-seahorse",   -0.743643887037151, 0.131825904205330, 1e-11 },
+    };
+    const Precision kernels[] = { Precision::Float, Precision::Double, Precision::FixedPoint };
+
+    FractalParams params;
+    std::vector<int> out(BENCH_WIDTH * BENCH_HEIGHT);
+    FrameKernel kernel;
+
+    std::printf("\n%-16s %10s %10s %10s %10s %s\n", "viewport",
+                "float Mi/s", "double Mi/s", "fixed Mi/s", "fixed ms", "fixed checksum");
+    for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); ++i) {
+        Viewport view(BENCH_WIDTH, BENCH_HEIGHT);
+        view.centerReal = views[i].centerReal;
+        view.centerImag = views[i].centerImag;
+        view.pixelSize = views[i].pixelSize;
+
+        double rates[3];
+        double fixedTime = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            kernel.prepare(view, params, BENCH_ITERATIONS, kernels[k]);
+            double seconds = timeFrameKernel(kernel, out);
+            rates[k] = sumIterations(out) / seconds / 1e6;
+            fixedTime = seconds;
+        }
+        std::printf("%-16s %10.1f %10.1f %10.1f %10.2f %016llx\n", views[i].name,
+                    rates[0], rates[1], rates[2], fixedTime * 1000.0, checksum(out));
+    }
+}
+
+// Frame time of P workers claiming tiles in the given order: each worker
+// takes the next unclaimed tile as soon as it is free (list scheduling)
+static double simulateMakespan(const std::vector<TileTask>& tiles, const std::vector<double>& seconds,
+                               int workers) {
+    std::vector<double> freeAt(workers, 0.0);
+    double makespan = 0.0;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        std::vector<double>::iterator worker = std::min_element(freeAt.begin(), freeAt.end());
+        *worker += seconds[i];
+        makespan = std::max(makespan, *worker);
+    }
+    return makespan;
+}
+
+// Zoom into a boundary point frame by frame. Every frame's tiles are timed
+// once, then the frame time of 8 workers is simulated for row-major (FIFO)
+// claiming and for longest-first claiming predicted from the previous frame.
+// The tail is the frame time beyond a perfect split of the total work.
+static void benchTileOrder() {
+    const int width = 800;
+    const int height = 600;
+    const int workers = 8;
+    const int frames = 16;
+    const int iterations = 2000;
+
+    FractalParams params;
+    Viewport view(width, height);
+    view.centerReal = -0.7436438870;
+    view.centerImag = 0.1318259042;
+    view.pixelSize = 4e-3;
+    FrameKernel kernel;
+    TileCostMap costs;
+    std::vector<int> out(width * height);
+
+    double fifoTail = 0.0;
+    double lptTail = 0.0;
+    double fifoWorst = 0.0;
+    double lptWorst = 0.0;
+    std::printf("\n%-10s %10s %10s %10s %10s %10s\n", "pixel", "ideal ms", "fifo ms", "lpt ms",
+                "fifo tail", "lpt tail");
+    for (int frame = 0; frame < frames; ++frame) {
+        kernel.prepare(view, params, iterations, choosePrecision(view, params));
+        std::vector<TileTask> rowMajor = makeTiles(width, height, frame);
+        std::vector<TileTask> longest = rowMajor;
+        if (costs.isValid()) {
+            orderLongestFirst(longest, costs, view);
+        }
+
+        // Time every tile once, in row-major order
+        std::vector<double> rowSeconds(rowMajor.size());
+        double total = 0.0;
+        for (size_t i = 0; i < rowMajor.size(); ++i) {
+            TileTask& task = rowMajor[i];
+            const TileRect& r = task.rect;
+            auto start = std::chrono::steady_clock::now();
+            kernel.renderRect(r.x0, r.y0, r.x1, r.y1, &out[r.y0 * width + r.x0], width, &task.stats);
+            rowSeconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            task.done = true;
+            total += rowSeconds[i];
+        }
+
+        // Look the same measurements up in longest-first order
+        const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        std::vector<double> lptSeconds(longest.size());
+        for (size_t i = 0; i < longest.size(); ++i) {
+            lptSeconds[i] = rowSeconds[longest[i].rect.y0 / TILE_SIZE * tilesX + longest[i].rect.x0 / TILE_SIZE];
+        }
+
+        double ideal = total / workers;
+        double fifo = simulateMakespan(rowMajor, rowSeconds, workers);
+        double lpt = simulateMakespan(longest, lptSeconds, workers);
+        std::printf("%-10.1e %10.2f %10.2f %10.2f %9.1f%% %9.1f%%\n", view.pixelSize, ideal * 1000.0,
+                    fifo * 1000.0, lpt * 1000.0, (fifo / ideal - 1.0) * 100.0, (lpt / ideal - 1.0) * 100.0);
+        if (frame > 0) {
+            fifoTail += fifo / ideal - 1.0;
+            lptTail += lpt / ideal - 1.0;
+            fifoWorst = std::max(fifoWorst, fifo / ideal - 1.0);
+            lptWorst = std::max(lptWorst, lpt / ideal - 1.0);
+        }
+
+        costs.record(view, rowMajor);
+        view.zoomAt(width / 2 + 7, height / 2 - 5, 0.7);
+    }
+    std::printf("tail over ideal, frames 2-%d: fifo mean %.1f%% worst %.1f%%, lpt mean %.1f%% worst %.1f%%\n",
+                frames, fifoTail / (frames - 1) * 100.0, fifoWorst * 100.0,
+                lptTail / (frames - 1) * 100.0, lptWorst * 100.0);
+}
+
+int main() {
+    benchFormulas();
+    benchLaneRefill();
+    benchPrecisionLadder();
+    benchFixedPoint();
+    benchTileOrder();
+    return 0;
+}
@@ -0,0 +1,259 @@
+// Escape-time kernel benchmark suite (no SDL needed). Every kernel variant
+// renders every named viewport at several iteration limits; the results go
+// to stdout as JSON, progress to stderr. On Linux the timed runs are also
+// measured with hardware counters (see perf_counters.hpp), reported per run.
+//
+// Usage: mandelbrot_bench_suite [repetitions] > results.json
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "fractal.hpp"
+#include "perf_counters.hpp"
+#include "precision.hpp"
+
+// Frame size; every variant renders the same frames
+const int SUITE_WIDTH = 320;
+const int SUITE_HEIGHT = 240;
+
+// Untimed runs before measuring (cache, branch predictor, CPU clock), and
+// default number of timed runs
+const int SUITE_WARMUP = 1;
+const int SUITE_REPETITIONS = 5;
+
+const int SUITE_ITERATIONS[] = { 256, 1024, 4096 };
+const int SUITE_ITERATION_COUNT = 3;
+
+// Named viewports, from boundary-heavy to all-interior
+struct SuiteView {
+    const char* name;
+    double centerReal;
+    double centerImag;
+    double pixelSize;
+};
+
+const SuiteView SUITE_VIEWS[] = {
+    { "full-set",        -0.5,          0.0,         3.0 / SUITE_HEIGHT },
+    { "seahorse-valley", -0.743643,     0.131825,    1e-5 },
+    { "elephant-valley",  0.2925,       0.0165,      2e-5 },
+    // Period-20 minibrot on the real axis, as deep as double still resolves
+    { "deep-minibrot",   -1.98553694,   0.0,         1e-9 },
+    { "interior",        -0.2,          0.0,         1e-4 },
+};
+const int SUITE_VIEW_COUNT = 5;
+
+// A kernel to measure: row kernels cover the scalar and lockstep variants,
+// rect kernels the lane-refill ones
+struct SuiteKernel {
+    const char* name;
+    const char* family;
+    const char* type;
+    int lanes;
+    bool cardioid;
+    bool periodicity;
+    RowKernel row;
+    RectKernel rect;
+};
+
+// Index of the kernel whose output the others are checked against
+const int SUITE_REFERENCE = 1;
+
+// Timing of one kernel on one frame, in seconds
+struct SuiteStats {
+    double min;
+    double median;
+    double mean;
+    double stddev;
+};
+
+static std::vector<SuiteKernel> makeKernels() {
+    FractalParams params;
+    std::vector<SuiteKernel> kernels;
+    SuiteKernel k;
+
+    k = { "scalar-dynamic", "scalar", "double", 1, false, false, &renderRowSpanDynamic, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-double", "scalar", "double", 1, false, false, &renderRowSpanChecked<false, false, double>, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-double-cardioid", "scalar", "double", 1, true, false,
+          &renderRowSpanChecked<true, false, double>, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-double-periodicity", "scalar", "double", 1, false, true,
+          &renderRowSpanChecked<false, true, double>, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-double-both", "scalar", "double", 1, true, true, &renderRowSpanChecked<true, true, double>, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-float", "scalar", "float", 1, false, false, &renderRowSpanChecked<false, false, float>, nullptr };
+    kernels.push_back(k);
+    k = { "scalar-float-both", "scalar", "float", 1, true, true, &renderRowSpanChecked<true, true, float>, nullptr };
+    kernels.push_back(k);
+    k = { "lockstep-double", "lockstep", "double", KERNEL_LANES, false, false, selectRowKernel<double>(params), nullptr };
+    kernels.push_back(k);
+    k = { "lockstep-float", "lockstep", "float", KERNEL_LANES, false, false, selectRowKernel<float>(params), nullptr };
+    kernels.push_back(k);
+    k = { "refill-double", "refill", "double", LaneWidth<double>::value, false, false, nullptr,
+          selectRectKernel<double>(params) };
+    kernels.push_back(k);
+    k = { "refill-float", "refill", "float", LaneWidth<float>::value, false, false, nullptr,
+          selectRectKernel<float>(params) };
+    kernels.push_back(k);
+    return kernels;
+}
+
+// Function to render one frame with a kernel and return its wall time
+static double renderFrame(const SuiteKernel& kernel, const Viewport& view, int maxIterations,
+                          std::vector<int>& out) {
+    FractalParams params;
+    auto start = std::chrono::steady_clock::now();
+    if (kernel.rect != nullptr) {
+        kernel.rect(view, params, 0, 0, view.width, view.height, maxIterations, out.data(), view.width, nullptr);
+    } else {
+        for (int y = 0; y < view.height; ++y) {
+            kernel.row(view, params, y, 0, view.width, maxIterations, &out[y * view.width]);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static SuiteStats summarize(std::vector<double> seconds) {
+    std::sort(seconds.begin(), seconds.end());
+    SuiteStats stats;
+    size_t n = seconds.size();
+    stats.min = seconds[0];
+    stats.median = n % 2 == 1 ? seconds[n / 2] : 0.5 * (seconds[n / 2 - 1] + seconds[n / 2]);
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        sum += seconds[i];
+    }
+    stats.mean = sum / n;
+    double squares = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        squares += (seconds[i] - stats.mean) * (seconds[i] - stats.mean);
+    }
+    stats.stddev = n > 1 ? std::sqrt(squares / (n - 1)) : 0.0;
+    return stats;
+}
+
+// Function to print a counter sample, divided over runs, as a JSON object.
+// Counters that could not be read are null.
+static void printCounters(const PerfSample& sample, int runs, long long iterations) {
+    std::printf("     \"counters\": {");
+    for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+        if (sample.valid[c]) {
+            std::printf("\"%s\": %.0f, ", PERF_COUNTER_NAMES[c], sample.values[c] / runs);
+        } else {
+            std::printf("\"%s\": null, ", PERF_COUNTER_NAMES[c]);
+        }
+    }
+    if (sample.ipc() > 0.0) {
+        std::printf("\"ipc\": %.3f, \"cycles_per_iteration\": %.3f}",
+                    sample.ipc(), sample.values[PERF_CYCLES] / runs / iterations);
+    } else {
+        std::printf("\"ipc\": null, \"cycles_per_iteration\": null}");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int repetitions = SUITE_REPETITIONS;
+    if (argc > 1) {
+        repetitions = std::atoi(argv[1]);
+        if (repetitions < 1) {
+            std::fprintf(stderr, "Usage: %s [repetitions]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<SuiteKernel> kernels = makeKernels();
+    const int pixels = SUITE_WIDTH * SUITE_HEIGHT;
+    std::vector<int> reference(pixels);
+    std::vector<int> out(pixels);
+    PerfCounters counters;
+    if (!counters.available()) {
+        std::fprintf(stderr, "No hardware counters: %s\n", counters.reason().c_str());
+    }
+
+    std::printf("{\n");
+    std::printf("  \"width\": %d,\n  \"height\": %d,\n", SUITE_WIDTH, SUITE_HEIGHT);
+    std::printf("  \"warmup\": %d,\n  \"repetitions\": %d,\n", SUITE_WARMUP, repetitions);
+    std::printf("  \"timer\": \"std::chrono::steady_clock\",\n");
+    std::printf("  \"perf_counters\": {\"available\": %s, \"reason\": \"%s\"},\n",
+                counters.available() ? "true" : "false", counters.reason().c_str());
+#ifdef __VERSION__
+    std::printf("  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    std::printf("  \"results\": [");
+
+    bool first = true;
+    for (int v = 0; v < SUITE_VIEW_COUNT; ++v) {
+        const SuiteView& named = SUITE_VIEWS[v];
+        Viewport view(SUITE_WIDTH, SUITE_HEIGHT);
+        view.centerReal = named.centerReal;
+        view.centerImag = named.centerImag;
+        view.pixelSize = named.pixelSize;
+        // Float cannot tell apart the pixels of views the viewer would not
+        // render in float
+        bool floatResolves = choosePrecision(view, FractalParams()) == Precision::Float;
+
+        for (int m = 0; m < SUITE_ITERATION_COUNT; ++m) {
+            int maxIterations = SUITE_ITERATIONS[m];
+
+            // Exact answers from the plain double loop (scalar-double)
+            renderFrame(kernels[SUITE_REFERENCE], view, maxIterations, reference);
+            long long iterations = 0;
+            for (int i = 0; i < pixels; ++i) {
+                iterations += reference[i];
+            }
+
+            for (size_t k = 0; k < kernels.size(); ++k) {
+                const SuiteKernel& kernel = kernels[k];
+
+                if (std::string(kernel.type) == "float" && !floatResolves) {
+                    continue;
+                }
+                std::fprintf(stderr, "%-16s %5d %s\n", named.name, maxIterations, kernel.name);
+
+                for (int w = 0; w < SUITE_WARMUP; ++w) {
+                    renderFrame(kernel, view, maxIterations, out);
+                }
+                std::vector<double> seconds;
+                counters.start();
+                for (int r = 0; r < repetitions; ++r) {
+                    seconds.push_back(renderFrame(kernel, view, maxIterations, out));
+                }
+                PerfSample sample = counters.stop();
+                SuiteStats stats = summarize(seconds);
+
+                int mismatched = 0;
+                for (int i = 0; i < pixels; ++i) {
+                    mismatched += out[i] != reference[i];
+                }
+
+                // Rates use the median run and count the reference
+                // iterations, so shortcuts that skip work show up as speed
+                std::printf("%s\n    {\"viewport\": \"%s\", \"center_real\": %.17g, \"center_imag\": %.17g, "
+                            "\"pixel_size\": %.17g, \"max_iterations\": %d,\n", first ? "" : ",",
+                            named.name, named.centerReal, named.centerImag, named.pixelSize, maxIterations);
+                std::printf("     \"kernel\": \"%s\", \"family\": \"%s\", \"type\": \"%s\", \"lanes\": %d, "
+                            "\"cardioid\": %s, \"periodicity\": %s,\n", kernel.name, kernel.family, kernel.type,
+                            kernel.lanes, kernel.cardioid ? "true" : "false", kernel.periodicity ? "true" : "false");
+                std::printf("     \"seconds\": {\"min\": %.9f, \"median\": %.9f, \"mean\": %.9f, \"stddev\": %.9f},\n",
+                            stats.min, stats.median, stats.mean, stats.stddev);
+                std::printf("     \"iterations\": %lld, \"giga_iterations_per_second\": %.4f, "
+                            "\"pixels_per_second\": %.1f, \"ns_per_pixel\": %.2f, \"mismatched_pixels\": %d,\n",
+                            iterations, iterations / stats.median * 1e-9, pixels / stats.median,
+                            stats.median * 1e9 / pixels, mismatched);
+                printCounters(sample, repetitions, iterations);
+                std::printf("}");
+                first = false;
+            }
+        }
+    }
+
+    std::printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef DEBUG_TEXT_HPP
+#define DEBUG_TEXT_HPP
+
+#include <SDL2/SDL.h>
+
+#include <vector>
+
+// Minimal bitmap text for debug overlays, since SDL2 itself cannot draw
+// text. A built-in 5x7 font covers digits, capital letters and a little
+// punctuation; lowercase is drawn as uppercase, anything else as a space.
+
+const int DEBUG_GLYPH_WIDTH = 5;
+const int DEBUG_GLYPH_HEIGHT = 7;
+
+// Characters of the font, in the order of DEBUG_FONT
+const char DEBUG_FONT_CHARS[] = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:/%-=";
+
+// One byte per glyph row, top first; bit 4 is the leftmost pixel
+const unsigned char DEBUG_FONT[][DEBUG_GLYPH_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // '0'
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // '1'
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // '2'
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // '3'
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // '4'
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // '5'
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // '6'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // '8'
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // '9'
+    { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'A'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // 'B'
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // 'C'
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // 'D'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // 'E'
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // 'F'
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // 'G'
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // 'H'
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 'I'
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // 'J'
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // 'L'
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'O'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // 'P'
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // 'Q'
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // 'R'
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // 'S'
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // 'U'
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // 'V'
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // 'W'
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // 'X'
+    { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 }, // 'Y'
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // 'Z'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // '.'
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // ':'
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // '-'
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // '='
+};
+
+// Function to draw text with the renderer's current draw color. Each font
+// pixel becomes a scale x scale square; characters advance by 6 * scale.
+inline void drawDebugText(SDL_Renderer* renderer, int x, int y, const char* text, int scale) {
+    std::vector<SDL_Rect> rects;
+    for (int c = 0; text[c] != '\0'; ++c) {
+        char ch = text[c];
+        if (ch >= 'a' && ch <= 'z') {
+            ch = static_cast<char>(ch - 'a' + 'A');
+        }
+        int glyph = 0;
+        for (int g = 0; DEBUG_FONT_CHARS[g] != '\0'; ++g) {
+            if (DEBUG_FONT_CHARS[g] == ch) {
+                glyph = g;
+                break;
+            }
+        }
+        int left = x + c * (DEBUG_GLYPH_WIDTH + 1) * scale;
+        for (int row = 0; row < DEBUG_GLYPH_HEIGHT; ++row) {
+            for (int col = 0; col < DEBUG_GLYPH_WIDTH; ++col) {
+                if (DEBUG_FONT[glyph][row] & (0x10 >> col)) {
+                    SDL_Rect rect = { left + col * scale, y + row * scale, scale, scale };
+                    rects.push_back(rect);
+                }
+            }
+        }
+    }
+    if (!rects.empty()) {
+        SDL_RenderFillRects(renderer, rects.data(), static_cast<int>(rects.size()));
+    }
+}
+
+#endif
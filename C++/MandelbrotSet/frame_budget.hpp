@@ -0,0 +1,111 @@
+#ifndef FRAME_BUDGET_HPP
+#define FRAME_BUDGET_HPP
+
+#include "fractal.hpp"
+
+// Frame-budget quality control for animated zooms.
+//
+// Every displayed frame gets FRAME_BUDGET_SECONDS. Before a frame is
+// submitted, FrameBudget predicts its cost from what the previous frames
+// measured (lane slots per sample and per iteration, and lane slots per
+// second across all workers) and picks the best quality that fits: full
+// resolution first, then fewer iterations, then one sample per 2x2, 4x4 or
+// 8x8 block of pixels. Tiles that still miss the deadline show the
+// previous frame, scaled to the new view, until they arrive.
+
+const double FRAME_BUDGET_SECONDS = 1.0 / 60.0;
+
+// Share of the budget a prediction may use; the rest absorbs misprediction
+const double BUDGET_HEADROOM = 0.8;
+
+// Pixels per sample along each axis, best first. WIDTH and HEIGHT must be
+// multiples of the largest so samples line up with screen pixels.
+const int BUDGET_STEPS[] = { 1, 2, 4, 8 };
+const int BUDGET_STEP_COUNT = 4;
+
+// How far the iteration count may drop below the requested one
+const int BUDGET_ITERATION_LEVELS = 3;
+
+// Weight of the newest measurement in the running averages
+const double BUDGET_SMOOTHING = 0.3;
+
+struct FrameQuality {
+    int step;
+    int maxIterations;
+};
+
+class FrameBudget {
+private:
+    double slotsPerSecond;          // all workers together
+    double slotsPerSampleIteration; // work of one sample, per allowed iteration
+    bool measured;
+
+    static double blend(double average, double sample) {
+        return average + BUDGET_SMOOTHING * (sample - average);
+    }
+
+public:
+    FrameBudget() : slotsPerSecond(0.0), slotsPerSampleIteration(0.0), measured(false) {}
+
+    // Function to record a frame, finished or cut short: the lane slots and
+    // summed tile seconds of the tiles that were rendered, and the share of
+    // the frame's samples they covered
+    void record(double slots, double tileSeconds, int threads, double fractionDone,
+                long long samples, int maxIterations) {
+        if (slots <= 0.0 || tileSeconds <= 0.0 || fractionDone <= 0.0) {
+            // Not one tile made it: the frame cost at least twice the guess
+            slotsPerSampleIteration *= 2.0;
+            return;
+        }
+        double throughput = slots / tileSeconds * threads;
+        double perSample = slots / fractionDone / samples / maxIterations;
+        if (!measured) {
+            slotsPerSecond = throughput;
+            slotsPerSampleIteration = perSample;
+            measured = true;
+        } else {
+            slotsPerSecond = blend(slotsPerSecond, throughput);
+            slotsPerSampleIteration = blend(slotsPerSampleIteration, perSample);
+        }
+    }
+
+    // Function to pick the best quality whose predicted render time fits
+    // the budget. Until something is measured, start coarse.
+    FrameQuality choose(int width, int height, int maxIterations) const {
+        FrameQuality quality;
+        quality.step = BUDGET_STEPS[BUDGET_STEP_COUNT - 1];
+        quality.maxIterations = maxIterations / 2;
+        if (!measured) {
+            quality.step = 4;
+            quality.maxIterations = maxIterations;
+            return quality;
+        }
+
+        for (int s = 0; s < BUDGET_STEP_COUNT; ++s) {
+            for (int level = 0; level < BUDGET_ITERATION_LEVELS; ++level) {
+                // Iterations 100%, 75% and 50% of the requested count
+                int iterations = maxIterations * (4 - level) / 4;
+                double samples = static_cast<double>(width / BUDGET_STEPS[s]) * (height / BUDGET_STEPS[s]);
+                double seconds = samples * iterations * slotsPerSampleIteration / slotsPerSecond;
+                if (seconds <= FRAME_BUDGET_SECONDS * BUDGET_HEADROOM) {
+                    quality.step = BUDGET_STEPS[s];
+                    quality.maxIterations = iterations;
+                    return quality;
+                }
+            }
+        }
+        return quality;
+    }
+};
+
+// Function to get the view that renders one sample per step x step block of
+// pixels: sample (i, j) lands on screen pixel (i * step, j * step)
+inline Viewport sampleView(const Viewport& view, int step) {
+    Viewport sampled = view;
+    sampled.width = view.width / step;
+    sampled.height = view.height / step;
+    sampled.pixelSize = view.pixelSize * step;
+    return sampled;
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+// Where the time of a frame goes. Compute is the wall time from submitting
+// a frame until its last tile comes back from the workers; the other
+// stages are main-thread time summed over every pass that uploaded part of
+// the frame. Total runs from submit to the present that showed the last
+// tile. All timing uses SDL_GetPerformanceCounter.
+
+enum FrameStage {
+    STAGE_COMPUTE,
+    STAGE_COLORIZE,
+    STAGE_UPLOAD,
+    STAGE_PRESENT,
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+
+const char* const STAGE_NAMES[STAGE_COUNT] = { "compute", "colorize", "upload", "present", "total" };
+
+// Frames in the rolling percentiles, and the span the frame rate is over
+const int STATS_WINDOW = 240;
+const double FPS_WINDOW_SECONDS = 1.0;
+
+struct FrameTiming {
+    int frame;
+    double startMs;  // since the program started
+    bool complete;   // false if the next frame replaced it first
+    int step;
+    int maxIterations;
+    const char* precision;
+    int tiles;
+    int cachedTiles;
+    long long iterations;
+    double stageMs[STAGE_COUNT];
+};
+
+// The last STATS_WINDOW samples of one stage
+class RollingPercentiles {
+private:
+    std::vector<double> samples;
+    size_t next;
+
+public:
+    RollingPercentiles() : next(0) {}
+
+    void add(double value) {
+        if (samples.size() < static_cast<size_t>(STATS_WINDOW)) {
+            samples.push_back(value);
+        } else {
+            samples[next] = value;
+            next = (next + 1) % samples.size();
+        }
+    }
+
+    // Function to get the p-th percentile (0 to 100), nearest rank
+    double percentile(double p) const {
+        if (samples.empty()) {
+            return 0.0;
+        }
+        std::vector<double> sorted(samples);
+        size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    }
+};
+
+class FrameStats {
+private:
+    Uint64 origin;
+    double ticksToMs;
+    double firstPixel; // ms from startup to the first fractal pixel shown, or -1
+
+    std::vector<FrameTiming> frames; // every frame, for the CSV
+    FrameTiming current;
+    Uint64 currentStart;
+    bool inFlight;
+    bool computed;
+
+    RollingPercentiles stages[STAGE_COUNT];
+    std::deque<Uint64> presents; // recent present times, oldest first
+
+    // Work and compute time of the complete frames in the window
+    std::deque<double> windowIterations;
+    std::deque<double> windowComputeMs;
+
+    double elapsedMs(Uint64 from, Uint64 to) const { return (to - from) * ticksToMs; }
+    Uint64 fpsWindowTicks() const { return static_cast<Uint64>(FPS_WINDOW_SECONDS * 1000.0 / ticksToMs); }
+
+    void finishFrame(bool complete) {
+        current.complete = complete;
+        frames.push_back(current);
+        inFlight = false;
+        if (!complete) {
+            return;
+        }
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            stages[s].add(current.stageMs[s]);
+        }
+        if (windowIterations.size() >= static_cast<size_t>(STATS_WINDOW)) {
+            windowIterations.pop_front();
+            windowComputeMs.pop_front();
+        }
+        windowIterations.push_back(static_cast<double>(current.iterations));
+        windowComputeMs.push_back(current.stageMs[STAGE_COMPUTE]);
+    }
+
+public:
+    FrameStats()
+        : origin(SDL_GetPerformanceCounter()),
+          ticksToMs(1000.0 / SDL_GetPerformanceFrequency()),
+          firstPixel(-1.0), currentStart(0), inFlight(false), computed(false) {}
+
+    Uint64 now() const { return SDL_GetPerformanceCounter(); }
+
+    // Function to start timing a newly submitted frame. A frame still in
+    // flight was replaced before it finished and is kept as incomplete.
+    void beginFrame(int step, int maxIterations, const char* precision) {
+        if (inFlight) {
+            current.stageMs[STAGE_COMPUTE] = elapsedMs(currentStart, now());
+            current.stageMs[STAGE_TOTAL] = current.stageMs[STAGE_COMPUTE];
+            finishFrame(false);
+        }
+        currentStart = now();
+        current = FrameTiming();
+        current.frame = static_cast<int>(frames.size());
+        current.startMs = elapsedMs(origin, currentStart);
+        current.step = step;
+        current.maxIterations = maxIterations;
+        current.precision = precision;
+        inFlight = true;
+        computed = false;
+    }
+
+    // Function to add the time since start to a main-thread stage
+    void add(FrameStage stage, Uint64 start) {
+        if (inFlight) {
+            current.stageMs[stage] += elapsedMs(start, now());
+        }
+    }
+
+    // Function to note that the last tile of the frame has arrived
+    void computeDone(int tiles, int cachedTiles, long long iterations) {
+        if (!inFlight) {
+            return;
+        }
+        current.stageMs[STAGE_COMPUTE] = elapsedMs(currentStart, now());
+        current.tiles = tiles;
+        current.cachedTiles = cachedTiles;
+        current.iterations = iterations;
+        computed = true;
+    }
+
+    // Function to note a present; showedTiles if it showed fractal pixels.
+    // Completes the frame once its last tile has been presented.
+    void presented(bool showedTiles) {
+        Uint64 time = now();
+        presents.push_back(time);
+        while (time - presents.front() > fpsWindowTicks()) {
+            presents.pop_front();
+        }
+        if (showedTiles && firstPixel < 0.0) {
+            firstPixel = elapsedMs(origin, time);
+        }
+        if (inFlight && computed) {
+            current.stageMs[STAGE_TOTAL] = elapsedMs(currentStart, time);
+            finishFrame(true);
+        }
+    }
+
+    // Presents per second over the last FPS_WINDOW_SECONDS
+    double fps() const {
+        Uint64 time = now();
+        int count = 0;
+        for (size_t i = 0; i < presents.size(); ++i) {
+            count += time - presents[i] <= fpsWindowTicks();
+        }
+        return count / FPS_WINDOW_SECONDS;
+    }
+
+    // Millions of iterations per second of compute, over the recent frames
+    double miterPerSecond() const {
+        double iterations = 0.0;
+        double ms = 0.0;
+        for (size_t i = 0; i < windowIterations.size(); ++i) {
+            iterations += windowIterations[i];
+            ms += windowComputeMs[i];
+        }
+        return ms > 0.0 ? iterations / ms / 1000.0 : 0.0;
+    }
+
+    double percentile(FrameStage stage, double p) const { return stages[stage].percentile(p); }
+    double firstPixelMs() const { return firstPixel; }
+    int frameCount() const { return static_cast<int>(frames.size()); }
+
+    // Function to print the rolling percentiles of every stage
+    void printSummary() const {
+        std::printf("%-9s %9s %9s %9s   (ms, last %d complete frames)\n", "stage", "p50", "p95", "p99", STATS_WINDOW);
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            std::printf("%-9s %9.2f %9.2f %9.2f\n", STAGE_NAMES[s], stages[s].percentile(50.0),
+                        stages[s].percentile(95.0), stages[s].percentile(99.0));
+        }
+        std::printf("first pixel after %.1f ms, %.1f Miter/s\n", firstPixel, miterPerSecond());
+    }
+
+    // Function to write one CSV row per frame, complete or not
+    bool writeCsv(const char* path) const {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr) {
+            return false;
+        }
+        std::fprintf(file, "frame,start_ms,complete,step,max_iterations,precision,tiles,cached_tiles,iterations");
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            std::fprintf(file, ",%s_ms", STAGE_NAMES[s]);
+        }
+        std::fprintf(file, "\n");
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const FrameTiming& f = frames[i];
+            std::fprintf(file, "%d,%.3f,%d,%d,%d,%s,%d,%d,%lld", f.frame, f.startMs, f.complete ? 1 : 0, f.step,
+                         f.maxIterations, f.precision, f.tiles, f.cachedTiles, f.iterations);
+            for (int s = 0; s < STAGE_COUNT; ++s) {
+                std::fprintf(file, ",%.3f", f.stageMs[s]);
+            }
+            std::fprintf(file, "\n");
+        }
+        return std::fclose(file) == 0;
+    }
+};
+
+#endif
@@ -0,0 +1,310 @@
+// Golden-image regression check for the fractal core (headless, no window).
+//
+// Renders a fixed set of views through libmandel, the same path both
+// viewers use, and compares the MD5 of each iteration buffer against
+// golden/manifest.txt. The golden buffers themselves are stored next to it
+// as 16-bit PGM images, so a failing view gets a per-pixel diff summary and
+// the images can be opened in any viewer.
+//
+// Usage: mandelbrot_golden [--update] [golden directory]
+//   --update  render every view and overwrite the golden files
+#include <SDL2/SDL_test_md5.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "mandel.h"
+
+// Frame size of every golden view
+const int GOLDEN_WIDTH = 160;
+const int GOLDEN_HEIGHT = 120;
+
+// Differences listed one by one in a failure report
+const int GOLDEN_LISTED_DIFFS = 5;
+
+struct GoldenCase {
+    const char* name;
+    double centerReal;
+    double centerImag;
+    double centerRealLo;
+    double centerImagLo;
+    double pixelSize;
+    int maxIterations; // at most 65535, the PGM maximum
+    int formula;
+    int power;
+    bool julia;
+    int precision;
+};
+
+// One view per precision rung and per formula. The deep views frame the
+// period-22 minibrot on the real axis at 4e-17 per pixel, past what double
+// can resolve.
+const GoldenCase GOLDEN_CASES[] = {
+    { "mandelbrot-float",     -0.5, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_FLOAT },
+    { "mandelbrot-double",    -0.5, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_DOUBLE },
+    { "seahorse-double",      -0.743643, 0.131825, 0.0, 0.0, 2e-5, 1000, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_DOUBLE },
+    { "seahorse-fixed-point", -0.743643, 0.131825, 0.0, 0.0, 2e-5, 1000, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_FIXED_POINT },
+    { "deep-double-double",   -1.9899514826217779, 0.0, 0.0, 0.0, 4e-17, 5000, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_DOUBLE_DOUBLE },
+    { "deep-perturbation",    -1.9899514826217779, 0.0, 0.0, 0.0, 4e-17, 5000, MANDEL_MULTIBROT, 2, false,
+      MANDEL_PRECISION_PERTURBATION },
+    { "multibrot-5",           0.0, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_MULTIBROT, 5, false,
+      MANDEL_PRECISION_DOUBLE },
+    { "burning-ship",         -0.4, -0.5, 0.0, 0.0, 3.5 / GOLDEN_HEIGHT, 500, MANDEL_BURNING_SHIP, 2, false,
+      MANDEL_PRECISION_DOUBLE },
+    { "tricorn",              -0.3, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_TRICORN, 2, false,
+      MANDEL_PRECISION_DOUBLE },
+    { "julia",                 0.0, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_MULTIBROT, 2, true,
+      MANDEL_PRECISION_DOUBLE },
+    { "julia-fixed-point",     0.0, 0.0, 0.0, 0.0, 3.0 / GOLDEN_HEIGHT, 500, MANDEL_MULTIBROT, 2, true,
+      MANDEL_PRECISION_FIXED_POINT },
+};
+const int GOLDEN_CASE_COUNT = sizeof(GOLDEN_CASES) / sizeof(GOLDEN_CASES[0]);
+
+// Function to serialize an iteration buffer as a binary 16-bit PGM
+// (big-endian samples, as the format requires)
+static std::vector<unsigned char> encodePgm(const std::vector<int>& iterations, int width, int height) {
+    char header[64];
+    int headerLength = std::snprintf(header, sizeof(header), "P5\n%d %d\n65535\n", width, height);
+    std::vector<unsigned char> bytes(header, header + headerLength);
+    bytes.reserve(headerLength + iterations.size() * 2);
+    for (size_t i = 0; i < iterations.size(); ++i) {
+        int n = std::min(std::max(iterations[i], 0), 65535);
+        bytes.push_back(static_cast<unsigned char>(n >> 8));
+        bytes.push_back(static_cast<unsigned char>(n & 0xFF));
+    }
+    return bytes;
+}
+
+// Function to read back a PGM written by encodePgm
+static bool decodePgm(const std::vector<unsigned char>& bytes, int width, int height,
+                      std::vector<int>& iterations) {
+    char header[64];
+    int headerLength = std::snprintf(header, sizeof(header), "P5\n%d %d\n65535\n", width, height);
+    size_t expected = headerLength + static_cast<size_t>(width) * height * 2;
+    if (bytes.size() != expected || std::memcmp(bytes.data(), header, headerLength) != 0) {
+        return false;
+    }
+    iterations.resize(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < iterations.size(); ++i) {
+        iterations[i] = (bytes[headerLength + 2 * i] << 8) | bytes[headerLength + 2 * i + 1];
+    }
+    return true;
+}
+
+static std::string md5Hex(const std::vector<unsigned char>& bytes) {
+    SDLTest_Md5Context context;
+    SDLTest_Md5Init(&context);
+    SDLTest_Md5Update(&context, const_cast<unsigned char*>(bytes.data()), static_cast<unsigned int>(bytes.size()));
+    SDLTest_Md5Final(&context);
+    char hex[33];
+    for (int i = 0; i < 16; ++i) {
+        std::snprintf(hex + 2 * i, 3, "%02x", context.digest[i]);
+    }
+    return std::string(hex);
+}
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& bytes) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    bytes.clear();
+    unsigned char buffer[65536];
+    size_t count;
+    while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+    std::fclose(file);
+    return true;
+}
+
+static bool writeFile(const std::string& path, const void* data, size_t size) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::fprintf(stderr, "Unable to write %s\n", path.c_str());
+        return false;
+    }
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::fprintf(stderr, "Unable to write %s\n", path.c_str());
+    }
+    return ok;
+}
+
+// Function to look up a view's digest in the manifest ("name md5" lines)
+static std::string manifestDigest(const std::vector<unsigned char>& manifest, const char* name) {
+    std::string text(manifest.begin(), manifest.end());
+    std::string key = std::string(name) + " ";
+    size_t line = 0;
+    while (line < text.size()) {
+        size_t end = text.find('\n', line);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (text.compare(line, key.size(), key) == 0) {
+            std::string digest = text.substr(line + key.size(), end - line - key.size());
+            if (!digest.empty() && digest[digest.size() - 1] == '\r') {
+                digest.erase(digest.size() - 1); // checked out with CRLF line endings
+            }
+            return digest;
+        }
+        line = end + 1;
+    }
+    return std::string();
+}
+
+// Function to print how a render differs from its golden image: how many
+// pixels changed and by how much, where, and whether any crossed the set
+// boundary (escaped in one, maxIterations in the other)
+static void printDiff(const std::vector<int>& golden, const std::vector<int>& actual, int width,
+                      int maxIterations) {
+    long long changed = 0;
+    long long crossed = 0;
+    long long sumDiff = 0;
+    int maxDiff = 0;
+    int minX = width, minY = GOLDEN_HEIGHT, maxX = -1, maxY = -1;
+    int listed = 0;
+
+    for (size_t i = 0; i < golden.size(); ++i) {
+        if (golden[i] == actual[i]) {
+            continue;
+        }
+        int x = static_cast<int>(i % width);
+        int y = static_cast<int>(i / width);
+        int diff = std::abs(golden[i] - actual[i]);
+        changed++;
+        sumDiff += diff;
+        maxDiff = std::max(maxDiff, diff);
+        crossed += (golden[i] == maxIterations) != (actual[i] == maxIterations);
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+        if (listed < GOLDEN_LISTED_DIFFS) {
+            std::printf("    (%d, %d): golden %d, now %d\n", x, y, golden[i], actual[i]);
+            listed++;
+        }
+    }
+
+    if (changed == 0) {
+        std::printf("    pixels identical; the golden file itself differs from its digest\n");
+        return;
+    }
+    std::printf("    %lld of %d pixels differ (%.3f%%), %lld crossed the set boundary\n",
+                changed, static_cast<int>(golden.size()), 100.0 * changed / golden.size(), crossed);
+    std::printf("    iteration difference: max %d, mean %.1f; bounding box (%d, %d)-(%d, %d)\n",
+                maxDiff, static_cast<double>(sumDiff) / changed, minX, minY, maxX, maxY);
+}
+
+int main(int argc, char* argv[]) {
+    bool update = false;
+    std::string directory = "golden";
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "Usage: %s [--update] [golden directory]\n", argv[0]);
+            return 2;
+        } else {
+            directory = argv[i];
+        }
+    }
+
+    mandel_context* context = mandel_create(0);
+    if (context == nullptr) {
+        std::fprintf(stderr, "Unable to start the fractal core\n");
+        return 2;
+    }
+
+    std::vector<unsigned char> manifest;
+    if (!update && !readFile(directory + "/manifest.txt", manifest)) {
+        std::fprintf(stderr, "No %s/manifest.txt; create it with --update\n", directory.c_str());
+        mandel_destroy(context);
+        return 2;
+    }
+
+    std::string newManifest;
+    std::vector<int> iterations(GOLDEN_WIDTH * GOLDEN_HEIGHT);
+    int failures = 0;
+
+    for (int c = 0; c < GOLDEN_CASE_COUNT; ++c) {
+        const GoldenCase& golden = GOLDEN_CASES[c];
+        mandel_request request;
+        mandel_request_init(&request, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+        request.center_real = golden.centerReal;
+        request.center_imag = golden.centerImag;
+        request.center_real_lo = golden.centerRealLo;
+        request.center_imag_lo = golden.centerImagLo;
+        request.pixel_size = golden.pixelSize;
+        request.max_iterations = golden.maxIterations;
+        request.formula = golden.formula;
+        request.power = golden.power;
+        request.julia = golden.julia ? 1 : 0;
+        request.precision = golden.precision;
+
+        if (mandel_render(context, &request, iterations.data()) != 0) {
+            std::printf("FAIL %-22s render failed: %s\n", golden.name, mandel_error(context));
+            failures++;
+            continue;
+        }
+        if (mandel_last_precision(context) != golden.precision) {
+            // Still compared; the pixels say whether the fallback matters
+            std::printf("note %-22s rendered with %s instead of %s\n", golden.name,
+                        mandel_precision_name(mandel_last_precision(context)),
+                        mandel_precision_name(golden.precision));
+        }
+
+        std::vector<unsigned char> image = encodePgm(iterations, GOLDEN_WIDTH, GOLDEN_HEIGHT);
+        std::string digest = md5Hex(image);
+        std::string path = directory + "/" + golden.name + ".pgm";
+
+        if (update) {
+            if (!writeFile(path, image.data(), image.size())) {
+                mandel_destroy(context);
+                return 2;
+            }
+            newManifest += std::string(golden.name) + " " + digest + "\n";
+            std::printf("wrote %-22s %s\n", golden.name, digest.c_str());
+            continue;
+        }
+
+        std::string expected = manifestDigest(manifest, golden.name);
+        if (expected == digest) {
+            std::printf("ok   %-22s %s\n", golden.name, digest.c_str());
+            continue;
+        }
+
+        failures++;
+        if (expected.empty()) {
+            std::printf("FAIL %-22s not in the manifest\n", golden.name);
+            continue;
+        }
+        std::printf("FAIL %-22s %s, golden %s\n", golden.name, digest.c_str(), expected.c_str());
+        std::vector<unsigned char> goldenImage;
+        std::vector<int> goldenIterations;
+        if (!readFile(path, goldenImage) ||
+            !decodePgm(goldenImage, GOLDEN_WIDTH, GOLDEN_HEIGHT, goldenIterations)) {
+            std::printf("    no readable golden image at %s\n", path.c_str());
+            continue;
+        }
+        printDiff(goldenIterations, iterations, GOLDEN_WIDTH, golden.maxIterations);
+    }
+
+    mandel_destroy(context);
+
+    if (update) {
+        return writeFile(directory + "/manifest.txt", newManifest.data(), newManifest.size()) ? 0 : 2;
+    }
+    std::printf("%d of %d views match\n", GOLDEN_CASE_COUNT - failures, GOLDEN_CASE_COUNT);
+    return failures == 0 ? 0 : 1;
+}
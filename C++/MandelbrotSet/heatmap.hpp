@@ -0,0 +1,116 @@
+#ifndef HEATMAP_HPP
+#define HEATMAP_HPP
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "tile_scheduler.hpp"
+
+// Debug colorings that show where the work of a frame went, in place of
+// the fractal palette. Tile modes outline every tile so the tile grid can
+// be compared against the structure of the view.
+
+enum HeatMode {
+    HEAT_OFF,
+    HEAT_ITERATIONS, // per pixel: iterations spent, log scale up to maxIterations
+    HEAT_TIME,       // per tile: worker wall time per pixel
+    HEAT_WORKER,     // per tile: which worker thread rendered it
+    HEAT_SOURCE,     // per tile: rendered, reused from the cache, or speculated
+    HEAT_MODE_COUNT
+};
+
+const char* const HEAT_MODE_NAMES[HEAT_MODE_COUNT] = {
+    "off", "iterations", "tile time", "worker", "tile source"
+};
+
+// One line of key for each mode, in the characters the debug font has
+const char* const HEAT_MODE_LEGENDS[HEAT_MODE_COUNT] = {
+    "",
+    "ITERATIONS  LOG SCALE  BLACK 0 - WHITE MAX",
+    "NS/PIXEL  LOG SCALE  BLACK 1 - WHITE 100000  GRAY CACHED",
+    "WORKER THREAD  ONE HUE EACH  GRAY CACHED",
+    "BLUE RENDERED  GREEN CACHED  MAGENTA SPECULATED"
+};
+
+// Range of the tile time scale, in decades of nanoseconds per pixel
+const double HEAT_TIME_DECADES = 5.0;
+
+const Uint32 HEAT_CACHED_GRAY = 0xFF404040u;
+
+// Function to map 0..1 onto black, blue, red, yellow, white
+inline Uint32 heatColor(double t) {
+    t = std::min(1.0, std::max(0.0, t));
+    const double stops[5][3] = { { 0, 0, 0 }, { 0, 0, 200 }, { 220, 0, 0 }, { 255, 220, 0 }, { 255, 255, 255 } };
+    double position = t * 4.0;
+    int i = std::min(3, static_cast<int>(position));
+    double f = position - i;
+    Uint32 color = 0xFF000000u;
+    for (int c = 0; c < 3; ++c) {
+        Uint32 channel = static_cast<Uint32>(stops[i][c] + (stops[i + 1][c] - stops[i][c]) * f + 0.5);
+        color |= channel << (16 - 8 * c);
+    }
+    return color;
+}
+
+// Function to pick a distinct, bright color for a worker index
+inline Uint32 workerColor(int worker) {
+    if (worker < 0) {
+        return HEAT_CACHED_GRAY;
+    }
+    // Golden-ratio steps around the hue circle keep neighbours apart
+    double hue = std::fmod(worker * 0.618033988749895, 1.0) * 6.0;
+    int sector = static_cast<int>(hue);
+    Uint32 rise = static_cast<Uint32>((hue - sector) * 200.0) + 55;
+    Uint32 fall = 255 - rise + 55;
+    const Uint32 low = 55;
+    const Uint32 channels[6][3] = {
+        { 255, rise, low }, { fall, 255, low }, { low, 255, rise },
+        { low, fall, 255 }, { rise, low, 255 }, { 255, low, fall }
+    };
+    return 0xFF000000u | channels[sector][0] << 16 | channels[sector][1] << 8 | channels[sector][2];
+}
+
+// Function to get the flat color of a tile in the tile modes
+inline Uint32 tileHeatColor(HeatMode mode, const TileTask& task) {
+    switch (mode) {
+        case HEAT_TIME: {
+            if (task.cached) {
+                return HEAT_CACHED_GRAY;
+            }
+            double nsPerPixel = task.seconds * 1e9 / std::max(1, task.area());
+            return heatColor(std::log10(std::max(1.0, nsPerPixel)) / HEAT_TIME_DECADES);
+        }
+        case HEAT_WORKER:
+            return workerColor(task.worker);
+        case HEAT_SOURCE:
+            if (!task.cached) {
+                return 0xFF2850B4u;
+            }
+            return task.speculated ? 0xFFC828C8u : 0xFF28A03Cu;
+        default:
+            return 0xFF000000u;
+    }
+}
+
+// Function to color one row of a tile; iterations holds the row's count
+// pixels, and top is true for the tile's first row
+inline void heatmapRow(HeatMode mode, const TileTask& task, const int* iterations, int count, int maxIterations,
+                       bool top, Uint32* out) {
+    if (mode == HEAT_ITERATIONS) {
+        double scale = 1.0 / std::log(1.0 + maxIterations);
+        for (int x = 0; x < count; ++x) {
+            out[x] = heatColor(std::log(1.0 + iterations[x]) * scale);
+        }
+        return;
+    }
+    Uint32 color = tileHeatColor(mode, task);
+    // Outline at half brightness
+    Uint32 edge = 0xFF000000u | (color >> 1 & 0x7F7F7Fu);
+    for (int x = 0; x < count; ++x) {
+        out[x] = top || x == 0 ? edge : color;
+    }
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Load generator for the tile server (mandelbrot_cpp --serve): several
+// keep-alive connections request random map tiles and the throughput and
+// latency percentiles are reported. Some requests can be abandoned (the
+// connection is closed before the answer) to exercise request dropping.
+// Usage: mandelbrot_loadgen [port connections requests max_zoom abandon_percent]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Defaults: a map viewer's worth of connections over the first zoom levels,
+// where tiles are shared between them and coalescing shows up
+const int LOADGEN_PORT = 8080;
+const int LOADGEN_CONNECTIONS = 8;
+const int LOADGEN_REQUESTS = 400;
+const int LOADGEN_MAX_ZOOM = 5;
+
+struct Connection {
+    int port;
+    int fd;
+
+    Connection(int serverPort) : port(serverPort), fd(-1) {}
+    ~Connection() { disconnect(); }
+
+    bool connectToServer() {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            disconnect();
+            return false;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        return true;
+    }
+
+    void disconnect() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    bool sendRequest(const std::string& path) {
+        if (fd < 0 && !connectToServer()) {
+            return false;
+        }
+        std::string request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+        return send(fd, request.data(), request.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(request.size());
+    }
+
+    // Function to read one response; returns the status code, or 0 on error
+    int readResponse(std::string& body) {
+        std::string data;
+        char chunk[16384];
+        size_t end;
+        while ((end = data.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                return 0;
+            }
+            data.append(chunk, static_cast<size_t>(got));
+        }
+        int status = 0;
+        std::sscanf(data.c_str(), "HTTP/1.1 %d", &status);
+        const char* length = std::strstr(data.c_str(), "Content-Length: ");
+        size_t size = length != nullptr ? std::strtoul(length + 16, nullptr, 10) : 0;
+        body = data.substr(end + 4);
+        while (body.size() < size) {
+            ssize_t got = recv(fd, chunk, std::min(sizeof(chunk), size - body.size()), 0);
+            if (got <= 0) {
+                return 0;
+            }
+            body.append(chunk, static_cast<size_t>(got));
+        }
+        if (data.find("Connection: close") != std::string::npos) {
+            disconnect();
+        }
+        return status;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    int port = argc > 1 ? std::atoi(argv[1]) : LOADGEN_PORT;
+    int connections = argc > 2 ? std::atoi(argv[2]) : LOADGEN_CONNECTIONS;
+    int requests = argc > 3 ? std::atoi(argv[3]) : LOADGEN_REQUESTS;
+    int maxZoom = argc > 4 ? std::atoi(argv[4]) : LOADGEN_MAX_ZOOM;
+    int abandonPercent = argc > 5 ? std::atoi(argv[5]) : 0;
+    connections = std::max(1, connections);
+
+    std::atomic<int> next(0);
+    std::atomic<int> errors(0);
+    std::atomic<int> abandoned(0);
+    std::atomic<long long> bytes(0);
+    std::vector<std::vector<double> > latencies(connections);
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int c = 0; c < connections; ++c) {
+        threads.push_back(std::thread([&, c] {
+            std::mt19937 random(1234u + c);
+            Connection connection(port);
+            std::string body;
+            while (next.fetch_add(1) < requests) {
+                int zoom = std::uniform_int_distribution<int>(0, maxZoom)(random);
+                int x = std::uniform_int_distribution<int>(0, (1 << zoom) - 1)(random);
+                int y = std::uniform_int_distribution<int>(0, (1 << zoom) - 1)(random);
+                std::string path = "/" + std::to_string(zoom) + "/" + std::to_string(x) + "/" +
+                                   std::to_string(y) + ".png";
+                bool abandon = std::uniform_int_distribution<int>(0, 99)(random) < abandonPercent;
+
+                auto sent = std::chrono::steady_clock::now();
+                if (!connection.sendRequest(path)) {
+                    errors++;
+                    connection.disconnect();
+                    continue;
+                }
+                if (abandon) {
+                    connection.disconnect();
+                    abandoned++;
+                    continue;
+                }
+                int status = connection.readResponse(body);
+                if (status != 200 || body.size() < 8 || body.compare(1, 3, "PNG") != 0) {
+                    errors++;
+                    connection.disconnect();
+                    continue;
+                }
+                latencies[c].push_back(
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+                bytes += static_cast<long long>(body.size());
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (int c = 0; c < connections; ++c) {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.empty()) {
+        std::printf("No tile was served (%d errors); is the server running on port %d?\n", errors.load(), port);
+        return 1;
+    }
+    auto percentile = [&](double p) { return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+
+    std::printf("%zu tiles in %.2f s over %d connections: %.1f tiles/s, %.1f KB per tile\n", all.size(), seconds,
+                connections, all.size() / seconds, bytes.load() / 1024.0 / all.size());
+    std::printf("Latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n", percentile(0.50), percentile(0.90),
+                percentile(0.99), all.back());
+    std::printf("Abandoned %d, errors %d\n", abandoned.load(), errors.load());
+
+    // The server's own counters: coalesced, dropped, cached, rendered
+    Connection connection(port);
+    std::string stats;
+    if (connection.sendRequest("/stats") && connection.readResponse(stats) == 200) {
+        std::printf("Server: %s", stats.c_str());
+    }
+    return errors.load() > 0 ? 1 : 0;
+}
+
+#else
+int main() {
+    std::printf("The load generator needs POSIX sockets\n");
+    return 1;
+}
+#endif
@@ -1,18 +1,176 @@
 #include <SDL2/SDL.h>
 #include <iostream>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "autotune.hpp"
+#include "buddhabrot.hpp"
+#include "debug_text.hpp"
+#include "frame_budget.hpp"
+#include "frame_stats.hpp"
+#include "fractal.hpp"
+#include "heatmap.hpp"
+#include "mandel.h"
+#include "png_writer.hpp"
+#include "precision.hpp"
+#include "qoi_writer.hpp"
+#include "render_farm.hpp"
+#include "tile_cache.hpp"
+#include "tile_scheduler.hpp"
+#include "tile_server.hpp"
+#include "trace.hpp"
+#include "zoom_sequence.hpp"
 
 // Window size constants
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
+// Speculation: tiles around the cursor at the next zoom level (radius in
+// tiles), and tiles past the screen edge in the direction of the last pan
+const int SPECULATIVE_ZOOM_RADIUS = 1;
+const int SPECULATIVE_PAN_TILES = 3;
+
+// Frames one mouse wheel notch is spread over in frame-budget mode
+const int ZOOM_ANIMATION_FRAMES = 20;
+
+// Where the X key writes the render trace
+const char* const TRACE_PATH = "mandel_trace.json";
+
+// Where the kernel tuning for this machine is kept between runs
+const char* const TUNE_PATH = "mandel_tune.cfg";
+
+// Where the S key saves screenshots: mandel_0000.png, mandel_0001.png, ...
+// (.qoi with Shift), skipping numbers already taken
+const char* const SCREENSHOT_PREFIX = "mandel_";
+
+// Headless benchmark (--bench): a zoom into Seahorse Valley, rendered
+// BENCH_PASSES times; the fastest pass is reported. It is also the training
+// run of the profile-guided build (see Makefile.linux).
+const int BENCH_FRAMES = 24;
+const int BENCH_PASSES = 3;
+const int BENCH_ITERATIONS = 1000;
+const double BENCH_ZOOM = 0.8;
+const double BENCH_CENTER_REAL = -0.743643;
+const double BENCH_CENTER_IMAG = 0.131825;
+
+// Encoder benchmark (--bench-encode): a frame of the same valley, each
+// format encoded ENCODE_REPEATS times; the fastest run is reported
+const int ENCODE_REPEATS = 5;
+const double ENCODE_PIXEL_SIZE = 2e-5;
+
 class MandelbrotRenderer {
 private:
     SDL_Window* window;
     SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    
+    // What is being drawn and where
+    FractalParams params;
+    Viewport viewport;
+    
+    // Colorized ARGB pixels; tiles are colorized here before upload
+    std::vector<Uint32> pixels;
+    
+    // Worker threads and the frame they are filling in. Workers post a
+    // tileEvent to wake the event loop when tiles are ready.
+    TileScheduler scheduler;
+    Uint32 tileEvent;
+    int frameGeneration;
+    int frameMaxIterations;
+    int frameTilesDone;
+    int frameCachedTiles;
+    Uint64 frameStart;
+    bool validatePrecisionMode;
+    
+    // Full-resolution view of the frame in flight, and pixels per sample
+    Viewport frameView;
+    int frameStep;
+    
+    // Work of the tiles finished so far, measured by the workers
+    double frameSlots;
+    double frameTileSeconds;
+    bool frameRecorded;
+    
+    // Frame-budget mode: hold 60 fps by lowering quality, and animate zooms
+    bool budgetMode;
+    FrameBudget budget;
+    int targetIterations;
+    int zoomFramesLeft;
+    double zoomPerFrame;
+    int zoomX;
+    int zoomY;
+    bool texturePending;
+    Uint64 budgetDeadline; // 0 when no budget frame is in progress
+    std::vector<Uint32> scratch;
+    
+    // Rendered tiles kept for reuse, and where speculation is aimed
+    TileCache cache;
+    int panX;
+    int panY;
+    int speculationTileX;
+    int speculationTileY;
+    
+    // Render with the fixed-point kernel so frames match across hosts
+    bool deterministicMode;
+    
+    // Stage timing of every frame, the overlay that shows it, and where to
+    // write it as CSV on exit (nullptr for nowhere)
+    FrameStats stats;
+    bool overlayMode;
+    const char* statsPath;
+    
+    // Heatmap coloring of where the work went, in place of the palette, and
+    // the tiles of the current frame shown so far, to recolor on a switch
+    HeatMode heatMode;
+    std::vector<const TileTask*> frameTiles;
+    
+    // Worker count, lane layout and float rung measured for this machine,
+    // and whether to measure again even if TUNE_PATH matches it
+    TuneConfig tuning;
+    bool retune;
+    
+    // Screenshots waiting for the saver thread, which encodes and writes
+    // them off the event loop
+    struct Screenshot {
+        std::vector<Uint32> pixels;
+        bool qoi;
+    };
+    StageQueue<Screenshot*> screenshots;
+    std::thread screenshotSaver;
+    int screenshotIndex;
+    
+    // Buddhabrot being sampled on its own thread, which posts a
+    // buddhabrotEvent carrying buddhabrotRun when done; stale events of a
+    // cancelled run carry an older number
+    std::unique_ptr<Buddhabrot> buddhabrot;
+    std::thread buddhabrotThread;
+    Uint32 buddhabrotEvent;
+    int buddhabrotRun;
+    Uint32 buddhabrotStart;
     
 public:
-    MandelbrotRenderer() : window(nullptr), renderer(nullptr) {}
+    MandelbrotRenderer()
+        : window(nullptr), renderer(nullptr), texture(nullptr),
+          viewport(WIDTH, HEIGHT),
+          pixels(WIDTH * HEIGHT),
+          tileEvent(0), frameGeneration(-1), frameMaxIterations(0), frameTilesDone(0), frameCachedTiles(0), frameStart(0),
+          validatePrecisionMode(false), frameView(WIDTH, HEIGHT), frameStep(1),
+          frameSlots(0.0), frameTileSeconds(0.0), frameRecorded(false),
+          budgetMode(false), targetIterations(1000), zoomFramesLeft(0), zoomPerFrame(1.0),
+          zoomX(0), zoomY(0), texturePending(false), budgetDeadline(0),
+          scratch(WIDTH * HEIGHT),
+          panX(0), panY(0), speculationTileX(-1), speculationTileY(-1),
+          deterministicMode(false), overlayMode(false), statsPath(nullptr), heatMode(HEAT_OFF),
+          retune(false), screenshotIndex(0), buddhabrotEvent(0), buddhabrotRun(0), buddhabrotStart(0) {}
     
     ~MandelbrotRenderer() {
         cleanup();
@@ -47,10 +205,88 @@ public:
             return false;
         }
         
+        // Create the streaming texture the frame is uploaded into
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+                                    SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+        if (texture == nullptr) {
+            std::cerr << "Unable to create texture: " << SDL_GetError() << std::endl;
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            SDL_Quit();
+            return false;
+        }
+        
+        tileEvent = SDL_RegisterEvents(2);
+        if (tileEvent == static_cast<Uint32>(-1)) {
+            std::cerr << "Unable to register tile event: " << SDL_GetError() << std::endl;
+            cleanup();
+            return false;
+        }
+        buddhabrotEvent = tileEvent + 1;
+        
+        // SDL_PushEvent is thread-safe; the scheduler posts at most one
+        // event per drain of its completion queue
+        Uint32 type = tileEvent;
+        scheduler.setWakeCallback([type] {
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = type;
+            SDL_PushEvent(&event);
+        });
+        scheduler.setFocus(WIDTH / 2, HEIGHT / 2);
+        scheduler.setCache(&cache);
+        
+        // Measured once per machine and library version, then loaded
+        if (retune || !loadTuneConfig(TUNE_PATH, tuning) || !matchesHost(tuning)) {
+            std::cout << "Tuning kernels for " << cpuModel() << "..." << std::endl;
+            tuning = autoTune();
+            std::cout << "Tuned in " << tuning.tuneMs << " ms" << std::endl;
+            if (!saveTuneConfig(TUNE_PATH, tuning)) {
+                std::cerr << "Unable to write " << TUNE_PATH << std::endl;
+            }
+        }
+        std::cout << "Kernels: " << (tuning.layout == LaneLayout::Lockstep ? "lockstep" : "refill") << " lanes, float "
+                  << (tuning.useFloat ? "on" : "off") << std::endl;
+        scheduler.setLaneLayout(tuning.layout);
+        scheduler.start(tuning.threads);
+        std::cout << "Rendering with " << scheduler.threadCount() << " threads" << std::endl;
+        
         return true;
     }
     
+    // Function to write the frame timings to a CSV file when the app exits
+    void setStatsPath(const char* path) {
+        statsPath = path;
+    }
+    
+    // Function to tune the kernels at startup even if a tuning is saved
+    void setRetune(bool on) {
+        retune = on;
+    }
+    
     void cleanup() {
+        stopBuddhabrot();
+        scheduler.stop();
+        // Screenshots still queued are written before exit
+        screenshots.close();
+        if (screenshotSaver.joinable()) {
+            screenshotSaver.join();
+        }
+        if (tracer().isEnabled()) {
+            toggleTrace();
+        }
+        if (statsPath != nullptr) {
+            if (stats.writeCsv(statsPath)) {
+                std::cout << "Wrote " << stats.frameCount() << " frame timings to " << statsPath << std::endl;
+            } else {
+                std::cerr << "Unable to write " << statsPath << std::endl;
+            }
+            statsPath = nullptr;
+        }
+        if (texture) {
+            SDL_DestroyTexture(texture);
+            texture = nullptr;
+        }
         if (renderer) {
             SDL_DestroyRenderer(renderer);
             renderer = nullptr;
@@ -62,67 +298,495 @@ public:
         SDL_Quit();
     }
     
-    // Function to check if a point is in the Mandelbrot set
-    int mandelbrot(double real, double imag, int maxIterations) {
-        double zReal = real;
-        double zImag = imag;
-        int iterations = 0;
-        
-        while (iterations < maxIterations && (zReal * zReal + zImag * zImag <= 4.0)) {
-            double newReal = zReal * zReal - zImag * zImag + real;
-            double newImag = 2.0 * zReal * zImag + imag;
-            
-            zReal = newReal;
-            zImag = newImag;
-            iterations++;
+    // Function to start drawing the current fractal; tiles appear as the
+    // workers finish them (see uploadCompletedTiles)
+    void drawMandelbrot(int maxIterations = 1000) {
+        targetIterations = maxIterations;
+        if (!budgetMode) {
+            submitFrame(1, maxIterations);
+            return;
         }
         
-        return iterations;
+        // Show the previous frame scaled to the new view until tiles arrive,
+        // and render at the best quality that fits the frame budget
+        recordFrame();
+        reprojectPreviousFrame();
+        FrameQuality quality = budget.choose(WIDTH, HEIGHT, maxIterations);
+        submitFrame(quality.step, quality.maxIterations);
     }
     
-    // Function to draw the Mandelbrot set
-    void drawMandelbrot(int maxIterations = 1000) {
-        // Range of complex coordinates
-        const double xMin = -2.0;
-        const double xMax = 1.0;
-        const double yMin = -1.5;
-        const double yMax = 1.5;
+    // Function to pick the precision frames of a view render at, with the
+    // tuned float decision applied. Cache groups are keyed by precision, so
+    // speculation must pick the same one.
+    Precision framePrecision(const Viewport& view) const {
+        if (deterministicMode) {
+            return chooseDeterministic(view, params);
+        }
+        return tunedPrecision(tuning, choosePrecision(view, params));
+    }
+    
+    // Function to submit the current view with one sample per step x step pixels
+    void submitFrame(int step, int maxIterations) {
+        stopBuddhabrot();
+        Viewport view = sampleView(viewport, step);
         
-        // Clear the screen
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
+        // One specialized kernel for the whole frame, at the cheapest precision
+        // that still resolves the pixel spacing
+        Precision precision = framePrecision(view);
+        if (deterministicMode && precision != Precision::FixedPoint && !budgetMode) {
+            std::cout << "Fixed point cannot render this view, using " << precisionName(precision) << std::endl;
+        }
+        
+        if (validatePrecisionMode) {
+            ValidationResult check = validatePrecision(view, params, maxIterations, precision);
+            std::cout << precisionName(check.selected) << " vs " << precisionName(check.reference)
+                      << ": " << check.mismatchedFraction * 100.0 << "% of pixels differ"
+                      << (check.visiblyDifferent ? " - VISIBLY DIFFERENT" : "") << std::endl;
+        }
+        
+        stats.beginFrame(step, maxIterations, precisionName(precision));
+        frameStart = SDL_GetPerformanceCounter();
+        frameMaxIterations = maxIterations;
+        frameTilesDone = 0;
+        frameCachedTiles = 0;
+        frameTiles.clear();
+        frameView = viewport;
+        frameStep = step;
+        frameSlots = 0.0;
+        frameTileSeconds = 0.0;
+        frameRecorded = false;
+        frameGeneration = scheduler.submit(view, params, maxIterations, precision);
+    }
+    
+    // Function to feed the measured work of the frame in flight, finished
+    // or not, to the frame budget
+    void recordFrame() {
+        if (frameGeneration < 0 || frameRecorded) {
+            return;
+        }
+        long long samples = static_cast<long long>(WIDTH / frameStep) * (HEIGHT / frameStep);
+        budget.record(frameSlots, frameTileSeconds, scheduler.threadCount(),
+                      static_cast<double>(frameTilesDone - frameCachedTiles) / scheduler.tileCount(frameGeneration),
+                      samples, frameMaxIterations);
+        frameRecorded = true;
+    }
+    
+    // Function to scale the displayed pixels of the previous frame into the
+    // current view; what was off screen before is painted black
+    void reprojectPreviousFrame() {
+        double originX, originY, nextX, nextY;
+        viewport.mapTo(frameView, 0.0, 0.0, originX, originY);
+        viewport.mapTo(frameView, 1.0, 1.0, nextX, nextY);
+        double scale = nextX - originX;
         
-        // Iterate through each pixel on the screen
         for (int y = 0; y < HEIGHT; ++y) {
+            int sy = static_cast<int>(std::floor(originY + y * scale + 0.5));
             for (int x = 0; x < WIDTH; ++x) {
-                // Calculate the complex coordinates for this pixel
-                double real = xMin + (xMax - xMin) * x / static_cast<double>(WIDTH);
-                double imag = yMin + (yMax - yMin) * y / static_cast<double>(HEIGHT);
-                
-                // Calculate Mandelbrot iterations
-                int iterations = mandelbrot(real, imag, maxIterations);
-                
-                // Create color based on iterations with better coloring scheme
-                if (iterations == maxIterations) {
-                    // Point is in the set - black
-                    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-                } else {
-                    // Point is not in the set - colorful
-                    int r = (iterations * 9) % 256;
-                    int g = (iterations * 15) % 256;
-                    int b = (iterations * 12) % 256;
-                    SDL_SetRenderDrawColor(renderer, r, g, b, 255);
+                int sx = static_cast<int>(std::floor(originX + x * scale + 0.5));
+                bool inside = sx >= 0 && sy >= 0 && sx < WIDTH && sy < HEIGHT;
+                scratch[y * WIDTH + x] = inside ? pixels[sy * WIDTH + sx] : 0xFF000000u;
+            }
+        }
+        pixels.swap(scratch);
+        SDL_UpdateTexture(texture, nullptr, pixels.data(), WIDTH * sizeof(Uint32));
+        texturePending = true;
+    }
+    
+    // Function to queue speculative tiles for idle time: the next zoom level
+    // around the cursor, then past the edge the view last panned towards
+    void requestSpeculation() {
+        if (deterministicMode || frameStep != 1 || frameGeneration < 0) {
+            return;
+        }
+        std::vector<SpeculativeTile> jobs;
+        int mouseX, mouseY;
+        SDL_GetMouseState(&mouseX, &mouseY);
+        speculationTileX = mouseX / TILE_SIZE;
+        speculationTileY = mouseY / TILE_SIZE;
+        
+        Viewport zoomed = viewport;
+        zoomed.zoomAt(mouseX, mouseY, 0.5);
+        if (zoomed.pixelSize >= MIN_PIXEL_SPACING) {
+            SpeculativeTile job;
+            job.group = cache.group(zoomed, params, frameMaxIterations, framePrecision(zoomed));
+            for (int radius = 0; radius <= SPECULATIVE_ZOOM_RADIUS; ++radius) {
+                for (int ty = speculationTileY - radius; ty <= speculationTileY + radius; ++ty) {
+                    for (int tx = speculationTileX - radius; tx <= speculationTileX + radius; ++tx) {
+                        bool ring = std::abs(tx - speculationTileX) == radius || std::abs(ty - speculationTileY) == radius;
+                        if (ring && tx >= 0 && ty >= 0 && tx * TILE_SIZE < WIDTH && ty * TILE_SIZE < HEIGHT) {
+                            job.tileX = tx;
+                            job.tileY = ty;
+                            jobs.push_back(job);
+                        }
+                    }
                 }
-                
-                SDL_RenderDrawPoint(renderer, x, y);
             }
         }
         
-        // Present the rendered frame
+        std::shared_ptr<CacheGroup> group = scheduler.cacheGroup(frameGeneration);
+        if (group && (panX != 0 || panY != 0)) {
+            // Screen tiles, grown by SPECULATIVE_PAN_TILES in the pan direction.
+            // Partial tiles on the screen edge are not cached yet and are
+            // rendered in full too; tiles the cache has are skipped.
+            const int tilesX = (WIDTH + TILE_SIZE - 1) / TILE_SIZE;
+            const int tilesY = (HEIGHT + TILE_SIZE - 1) / TILE_SIZE;
+            for (int depth = 0; depth <= SPECULATIVE_PAN_TILES; ++depth) {
+                for (int ty = std::min(0, panY * depth); ty < tilesY + std::max(0, panY * depth); ++ty) {
+                    for (int tx = std::min(0, panX * depth); tx < tilesX + std::max(0, panX * depth); ++tx) {
+                        int beyondX = tx < 0 ? -tx : std::max(0, tx - tilesX + 1);
+                        int beyondY = ty < 0 ? -ty : std::max(0, ty - tilesY + 1);
+                        if (std::max(beyondX, beyondY) == depth && !cache.contains(*group, tx, ty)) {
+                            SpeculativeTile job;
+                            job.group = group;
+                            job.tileX = tx;
+                            job.tileY = ty;
+                            jobs.push_back(job);
+                        }
+                    }
+                }
+            }
+        }
+        scheduler.speculate(jobs);
+    }
+    
+    // Function to tell whether frame-budget mode still has frames to show:
+    // a zoom animation, a frame in flight, or a frame left to refine
+    bool budgetWorkPending() const {
+        if (zoomFramesLeft > 0) {
+            return true;
+        }
+        if (frameGeneration < 0) {
+            return false;
+        }
+        return frameTilesDone < scheduler.tileCount(frameGeneration) ||
+               frameStep > 1 || frameMaxIterations < targetIterations;
+    }
+    
+    // Function to move a frame-budget frame along: take the next step of a
+    // zoom animation, or refine a finished low-quality frame of a still view
+    void advanceBudgetFrame() {
+        if (zoomFramesLeft > 0) {
+            zoomFramesLeft--;
+            if (viewport.pixelSize * zoomPerFrame >= MIN_PIXEL_SPACING) {
+                viewport.zoomAt(zoomX, zoomY, zoomPerFrame);
+                drawMandelbrot(targetIterations);
+            }
+            return;
+        }
+        
+        bool finished = frameGeneration >= 0 && frameTilesDone == scheduler.tileCount(frameGeneration);
+        if (finished && (frameStep > 1 || frameMaxIterations < targetIterations)) {
+            recordFrame();
+            submitFrame(std::max(1, frameStep / 2), targetIterations);
+        }
+    }
+    
+    // Function to colorize and upload the tiles finished since the last call.
+    // Only the finished rectangles are sent to the texture.
+    // Tiles of reduced-density frames cover step x step pixels per sample.
+    void uploadCompletedTiles() {
+        bool updated = texturePending;
+        bool showedTiles = false;
+        texturePending = false;
+        const TileTask* task;
+        while ((task = scheduler.popCompleted()) != nullptr) {
+            if (task->generation != frameGeneration) {
+                continue;
+            }
+            drawTile(*task);
+            frameTiles.push_back(task);
+            updated = true;
+            showedTiles = true;
+            if (task->cached) {
+                frameCachedTiles++;
+            } else {
+                frameSlots += task->measuredCost();
+                frameTileSeconds += task->seconds;
+            }
+            
+            if (++frameTilesDone == scheduler.tileCount(frameGeneration)) {
+                double ms = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / SDL_GetPerformanceFrequency();
+                if (!budgetMode) {
+                    TileCacheStats stats = cache.getStats();
+                    std::cout << "Frame rendered in " << ms << " ms ("
+                              << precisionName(scheduler.precision(frameGeneration)) << ", "
+                              << frameCachedTiles << "/" << frameTilesDone << " tiles cached, speculation hit rate "
+                              << stats.hitRate() * 100.0 << "% of " << stats.speculatedTiles << ")" << std::endl;
+                }
+                recordFrame();
+                requestSpeculation();
+                stats.computeDone(frameTilesDone, frameCachedTiles, sumIterations());
+            }
+        }
+        
+        if (updated) {
+            present(showedTiles);
+        }
+    }
+    
+    // Function to colorize one finished tile of the current frame, with the
+    // palette or the heatmap, and upload it to the texture
+    void drawTile(const TileTask& task) {
+        const int step = frameStep;
+        const int sampleWidth = WIDTH / step;
+        const TileRect& r = task.rect;
+        const int* source = scheduler.iterations(frameGeneration);
+        Uint64 stageStart = stats.now();
+        uint64_t traceStart = tracer().begin();
+        Uint32 rowColors[TILE_SIZE];
+        for (int sy = r.y0; sy < r.y1; ++sy) {
+            if (heatMode == HEAT_OFF) {
+                mandel_colorize(&source[sy * sampleWidth + r.x0], r.x1 - r.x0, frameMaxIterations,
+                                MANDEL_PALETTE_BANDS, rowColors);
+            } else {
+                heatmapRow(heatMode, task, &source[sy * sampleWidth + r.x0], r.x1 - r.x0, frameMaxIterations,
+                           sy == r.y0, rowColors);
+            }
+            for (int y = sy * step; y < (sy + 1) * step; ++y) {
+                for (int x = r.x0 * step; x < r.x1 * step; ++x) {
+                    pixels[y * WIDTH + x] = rowColors[x / step - r.x0];
+                }
+            }
+        }
+        
+        stats.add(STAGE_COLORIZE, stageStart);
+        
+        stageStart = stats.now();
+        SDL_Rect rect = { r.x0 * step, r.y0 * step, (r.x1 - r.x0) * step, (r.y1 - r.y0) * step };
+        SDL_UpdateTexture(texture, &rect, &pixels[rect.y * WIDTH + rect.x], WIDTH * sizeof(Uint32));
+        stats.add(STAGE_UPLOAD, stageStart);
+        tracer().complete("upload", traceStart, frameGeneration, tileId(r, sampleWidth), "cached", task.cached);
+    }
+    
+    // Function to redraw the tiles of the current frame shown so far, after
+    // the coloring changed
+    void recolorFrame() {
+        // Nothing to recolor while a Buddhabrot is shown
+        if (frameGeneration < 0) {
+            return;
+        }
+        for (size_t i = 0; i < frameTiles.size(); ++i) {
+            drawTile(*frameTiles[i]);
+        }
+        texturePending = true;
+    }
+    
+    // Function to sum the iteration counts of the frame in flight
+    long long sumIterations() const {
+        const int* source = scheduler.iterations(frameGeneration);
+        long long total = 0;
+        for (int i = 0; i < (WIDTH / frameStep) * (HEIGHT / frameStep); ++i) {
+            total += source[i];
+        }
+        return total;
+    }
+    
+    // Function to show the texture, and the overlay on top when it is on.
+    // The overlay itself is left out of the present time.
+    void present(bool showedTiles) {
+        uint64_t traceStart = tracer().begin();
+        Uint64 stageStart = stats.now();
+        SDL_RenderClear(renderer);
+        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+        stats.add(STAGE_PRESENT, stageStart);
+        if (overlayMode) {
+            drawOverlay();
+        }
+        if (heatMode != HEAT_OFF) {
+            drawHeatLegend();
+        }
+        stageStart = stats.now();
         SDL_RenderPresent(renderer);
+        stats.add(STAGE_PRESENT, stageStart);
+        stats.presented(showedTiles);
+        tracer().complete("present", traceStart, frameGeneration);
+    }
+    
+    // Function to start recording a render trace, or stop and write it
+    void toggleTrace() {
+        if (!TRACE_COMPILED) {
+            std::cout << "Tracing was compiled out (MANDEL_NO_TRACE)" << std::endl;
+            return;
+        }
+        if (!tracer().isEnabled()) {
+            tracer().setEnabled(true);
+            std::cout << "Tracing render tasks; press X again to write " << TRACE_PATH << std::endl;
+            return;
+        }
+        tracer().setEnabled(false);
+        if (tracer().write(TRACE_PATH)) {
+            std::cout << "Wrote " << tracer().eventCount() << " trace events to " << TRACE_PATH
+                      << " (open it in Perfetto)" << std::endl;
+        } else {
+            std::cerr << "Unable to write " << TRACE_PATH << std::endl;
+        }
+    }
+    
+    // Function to queue the displayed frame to be saved as PNG (or QOI) by
+    // the saver thread; the event loop only copies the pixels
+    void saveScreenshot(bool qoi) {
+        Screenshot* shot = new Screenshot;
+        shot->pixels = pixels;
+        shot->qoi = qoi;
+        screenshots.push(shot);
+        if (!screenshotSaver.joinable()) {
+            screenshotSaver = std::thread(&MandelbrotRenderer::saveScreenshots, this);
+        }
+    }
+    
+    // Function run by the saver thread: encode and write queued screenshots
+    // until the queue is closed
+    void saveScreenshots() {
+        tracer().nameThread("screenshots");
+        int threads = std::max(1u, std::thread::hardware_concurrency());
+        Screenshot* shot;
+        while (screenshots.pop(shot)) {
+            char path[64];
+            for (;;) {
+                std::snprintf(path, sizeof(path), "%s%04d.%s", SCREENSHOT_PREFIX, screenshotIndex++,
+                              shot->qoi ? "qoi" : "png");
+                FILE* existing = std::fopen(path, "rb");
+                if (existing == nullptr) {
+                    break;
+                }
+                std::fclose(existing);
+            }
+            
+            auto start = std::chrono::steady_clock::now();
+            bool saved = shot->qoi ? saveQoi(path, shot->pixels.data(), WIDTH, HEIGHT, WIDTH)
+                                   : savePng(path, shot->pixels.data(), WIDTH, HEIGHT, WIDTH, threads);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (saved) {
+                std::printf("Saved %s in %.1f ms\n", path, ms);
+            } else {
+                std::fprintf(stderr, "Unable to write %s\n", path);
+            }
+            delete shot;
+        }
+    }
+    
+    // Function to draw the timing overlay: frame rate, throughput, busy
+    // workers, and the rolling percentiles of every frame stage
+    void drawOverlay() {
+        const int scale = 2;
+        const int lineHeight = (DEBUG_GLYPH_HEIGHT + 3) * scale;
+        char lines[STAGE_COUNT + 3][64];
+        int count = 0;
+        std::snprintf(lines[count++], sizeof(lines[0]), "FPS %.1f  MITER/S %.0f  THREADS %d/%d",
+                      stats.fps(), stats.miterPerSecond(), scheduler.activeWorkers(), scheduler.threadCount());
+        std::snprintf(lines[count++], sizeof(lines[0]), "FRAMES %d  FIRST PIXEL %.0f MS",
+                      stats.frameCount(), stats.firstPixelMs());
+        std::snprintf(lines[count++], sizeof(lines[0]), "MS          P50     P95     P99");
+        for (int s = 0; s < STAGE_COUNT; ++s) {
+            std::snprintf(lines[count++], sizeof(lines[0]), "%-8s %7.2f %7.2f %7.2f", STAGE_NAMES[s],
+                          stats.percentile(static_cast<FrameStage>(s), 50.0),
+                          stats.percentile(static_cast<FrameStage>(s), 95.0),
+                          stats.percentile(static_cast<FrameStage>(s), 99.0));
+        }
+        
+        SDL_Rect background = { 4, 4, 0, count * lineHeight + 2 * scale };
+        for (int i = 0; i < count; ++i) {
+            int width = static_cast<int>(std::strlen(lines[i])) * (DEBUG_GLYPH_WIDTH + 1) * scale;
+            background.w = std::max(background.w, width + 4 * scale);
+        }
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 176);
+        SDL_RenderFillRect(renderer, &background);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        for (int i = 0; i < count; ++i) {
+            drawDebugText(renderer, background.x + 2 * scale, background.y + 2 * scale + i * lineHeight,
+                          lines[i], scale);
+        }
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+    
+    // Function to draw the key of the heatmap along the bottom edge
+    void drawHeatLegend() {
+        const int scale = 2;
+        const char* legend = HEAT_MODE_LEGENDS[heatMode];
+        int width = static_cast<int>(std::strlen(legend)) * (DEBUG_GLYPH_WIDTH + 1) * scale;
+        SDL_Rect background = { 4, HEIGHT - (DEBUG_GLYPH_HEIGHT + 4) * scale - 4, width + 4 * scale,
+                                (DEBUG_GLYPH_HEIGHT + 4) * scale };
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 176);
+        SDL_RenderFillRect(renderer, &background);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        drawDebugText(renderer, background.x + 2 * scale, background.y + 2 * scale, legend, scale);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    }
+    
+    // Function to start sampling a Nebulabrot of the current view on its own
+    // thread; the event loop keeps running and shows it when it is done
+    void drawBuddhabrot() {
+        stopBuddhabrot();
+        
+        // The fractal frame in flight would compete for the cores and paint
+        // over the Buddhabrot
+        scheduler.cancel();
+        frameGeneration = -1;
+        frameTiles.clear();
+        frameTilesDone = 0;
+        zoomFramesLeft = 0;
+        budgetDeadline = 0;
+        
+        std::cout << "Sampling Buddhabrot orbits..." << std::endl;
+        buddhabrotStart = SDL_GetTicks();
+        buddhabrot.reset(new Buddhabrot(viewport, BuddhabrotSettings()));
+        Buddhabrot* sampling = buddhabrot.get();
+        Uint32 type = buddhabrotEvent;
+        int run = ++buddhabrotRun;
+        buddhabrotThread = std::thread([sampling, type, run] {
+            tracer().nameThread("buddhabrot");
+            sampling->render();
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = type;
+            event.user.code = run;
+            SDL_PushEvent(&event);
+        });
+    }
+    
+    // Function to show the Buddhabrot once its thread has posted that it is
+    // done; events of cancelled runs are ignored
+    void finishBuddhabrot(const SDL_Event& event) {
+        if (event.user.code != buddhabrotRun || !buddhabrotThread.joinable()) {
+            return;
+        }
+        buddhabrotThread.join();
+        buddhabrot->toPixels(pixels.data());
+        buddhabrot.reset();
+        std::cout << "Buddhabrot done in " << (SDL_GetTicks() - buddhabrotStart) << " ms" << std::endl;
+        SDL_UpdateTexture(texture, nullptr, pixels.data(), WIDTH * sizeof(Uint32));
+        present(false);
+    }
+    
+    // Function to cancel a Buddhabrot still being sampled and wait for its
+    // thread
+    void stopBuddhabrot() {
+        if (!buddhabrotThread.joinable()) {
+            return;
+        }
+        buddhabrot->cancel();
+        buddhabrotThread.join();
+        buddhabrot.reset();
+        std::cout << "Buddhabrot cancelled" << std::endl;
+    }
+    
+    // Function to describe the current fractal on the console
+    void printFractal() const {
+        const char* names[] = { "Multibrot", "Burning Ship", "Tricorn" };
+        std::cout << names[static_cast<int>(params.formula)];
+        if (params.formula == FormulaKind::Multibrot) {
+            std::cout << " (power " << params.power << ")";
+        }
+        std::cout << (params.julia ? " - Julia" : " - Mandelbrot") << std::endl;
     }
     
     void run() {
+        tracer().nameThread("main");
+        
         // Draw the Mandelbrot set
         drawMandelbrot(1000);
         
@@ -130,37 +794,491 @@ public:
         SDL_Event event;
         bool quit = false;
         
-        std::cout << "Mandelbrot Set rendered! Press ESC or close window to exit." << std::endl;
+        std::cout << "Mandelbrot Set rendering! Press ESC or close window to exit." << std::endl;
         std::cout << "Controls:" << std::endl;
         std::cout << "- Press R to re-render" << std::endl;
+        std::cout << "- Press F to cycle formula (Multibrot, Burning Ship, Tricorn)" << std::endl;
+        std::cout << "- Press UP/DOWN to change the Multibrot power" << std::endl;
+        std::cout << "- Press J to toggle Julia mode" << std::endl;
+        std::cout << "- Press B to render a Buddhabrot of the view" << std::endl;
+        std::cout << "- Mouse wheel to zoom at the cursor, left click to center" << std::endl;
+        std::cout << "- Press V to toggle precision validation" << std::endl;
+        std::cout << "- Press D to toggle deterministic fixed-point rendering" << std::endl;
+        std::cout << "- Press O to cycle tile order (row-major, longest first, cursor first)" << std::endl;
+        std::cout << "- Press T to toggle frame-budget mode (60 fps, animated zoom)" << std::endl;
+        std::cout << "- Press P to toggle the frame timing overlay" << std::endl;
+        std::cout << "- Press H to cycle work heatmaps (iterations, tile time, worker, tile source)" << std::endl;
+        std::cout << "- Press X to start/stop a render trace (" << TRACE_PATH << ")" << std::endl;
+        std::cout << "- Press S to save a screenshot as PNG (Shift+S: QOI)" << std::endl;
         std::cout << "- Press ESC or close window to exit" << std::endl;
         
         while (!quit) {
-            while (SDL_PollEvent(&event)) {
-                switch (event.type) {
-                    case SDL_QUIT:
-                        quit = true;
-                        break;
-                    case SDL_KEYDOWN:
-                        if (event.key.keysym.sym == SDLK_ESCAPE) {
-                            quit = true;
-                        } else if (event.key.keysym.sym == SDLK_r) {
-                            std::cout << "Re-rendering Mandelbrot set..." << std::endl;
-                            drawMandelbrot(1000);
-                        }
-                        break;
+            // Block until there is input, a worker finished a tile, or (in
+            // frame-budget mode) the current frame reaches its deadline
+            int timeout = -1;
+            if (budgetMode && budgetWorkPending()) {
+                if (budgetDeadline == 0) {
+                    // Start this tick's frame and give the workers the budget
+                    advanceBudgetFrame();
+                    budgetDeadline = SDL_GetPerformanceCounter() +
+                                     static_cast<Uint64>(FRAME_BUDGET_SECONDS * SDL_GetPerformanceFrequency());
                 }
+                Uint64 now = SDL_GetPerformanceCounter();
+                timeout = now >= budgetDeadline ? 0 : static_cast<int>((budgetDeadline - now) * 1000 /
+                                                                       SDL_GetPerformanceFrequency());
             }
             
-            // Small delay to prevent excessive CPU usage
-            SDL_Delay(16);
+            if (timeout < 0 ? SDL_WaitEvent(&event) : SDL_WaitEventTimeout(&event, timeout)) {
+                handleEvent(event, quit);
+                while (SDL_PollEvent(&event)) {
+                    handleEvent(event, quit);
+                }
+            }
+            
+            if (!budgetMode) {
+                uploadCompletedTiles();
+            } else if (budgetDeadline != 0 && SDL_GetPerformanceCounter() >= budgetDeadline) {
+                // Show whatever has finished by the deadline
+                uploadCompletedTiles();
+                budgetDeadline = 0;
+            }
+        }
+    }
+    
+    // Function to react to one event
+    void handleEvent(const SDL_Event& event, bool& quit) {
+        if (event.type == tileEvent) {
+            // Tiles are uploaded after the events are handled
+            return;
+        }
+        if (event.type == buddhabrotEvent) {
+            finishBuddhabrot(event);
+            return;
+        }
+        switch (event.type) {
+            case SDL_WINDOWEVENT:
+                // Redraw from the texture; nothing is re-rendered
+                if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                    texturePending = true;
+                }
+                break;
+            case SDL_QUIT:
+                quit = true;
+                break;
+            case SDL_KEYDOWN:
+                if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    quit = true;
+                } else if (event.key.keysym.sym == SDLK_r) {
+                    std::cout << "Re-rendering Mandelbrot set..." << std::endl;
+                    cache.clear();
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_f) {
+                    params.formula = static_cast<FormulaKind>((static_cast<int>(params.formula) + 1) % 3);
+                    printFractal();
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_UP && params.power < MAX_POWER) {
+                    params.power++;
+                    printFractal();
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_DOWN && params.power > MIN_POWER) {
+                    params.power--;
+                    printFractal();
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_j) {
+                    params.julia = !params.julia;
+                    viewport.centerReal = params.julia ? 0.0 : -0.5;
+                    printFractal();
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_b) {
+                    drawBuddhabrot();
+                } else if (event.key.keysym.sym == SDLK_v) {
+                    validatePrecisionMode = !validatePrecisionMode;
+                    std::cout << "Precision validation " << (validatePrecisionMode ? "on" : "off") << std::endl;
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_d) {
+                    deterministicMode = !deterministicMode;
+                    std::cout << "Deterministic rendering " << (deterministicMode ? "on" : "off") << std::endl;
+                    // Cached tiles were rendered at other centers, which
+                    // fixed point would not reproduce bit for bit
+                    scheduler.setCache(deterministicMode ? nullptr : &cache);
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_o) {
+                    const char* names[] = { "row-major", "longest first", "cursor first" };
+                    int next = (static_cast<int>(scheduler.getOrder()) + 1) % 3;
+                    scheduler.setOrder(static_cast<TileOrder>(next));
+                    std::cout << "Tile order: " << names[next] << std::endl;
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_t) {
+                    budgetMode = !budgetMode;
+                    zoomFramesLeft = 0;
+                    std::cout << "Frame-budget mode " << (budgetMode ? "on" : "off") << std::endl;
+                    drawMandelbrot(1000);
+                } else if (event.key.keysym.sym == SDLK_p) {
+                    overlayMode = !overlayMode;
+                    stats.printSummary();
+                    texturePending = true;
+                } else if (event.key.keysym.sym == SDLK_h) {
+                    heatMode = static_cast<HeatMode>((heatMode + 1) % HEAT_MODE_COUNT);
+                    std::cout << "Heatmap: " << HEAT_MODE_NAMES[heatMode] << std::endl;
+                    recolorFrame();
+                } else if (event.key.keysym.sym == SDLK_x) {
+                    toggleTrace();
+                } else if (event.key.keysym.sym == SDLK_s) {
+                    saveScreenshot((event.key.keysym.mod & KMOD_SHIFT) != 0);
+                }
+                break;
+            case SDL_MOUSEWHEEL: {
+                int mouseX, mouseY;
+                SDL_GetMouseState(&mouseX, &mouseY);
+                double factor = event.wheel.y > 0 ? 0.5 : 2.0;
+                if (budgetMode) {
+                    // Spread the zoom over the next frames
+                    zoomFramesLeft = ZOOM_ANIMATION_FRAMES;
+                    zoomPerFrame = std::pow(factor, 1.0 / ZOOM_ANIMATION_FRAMES);
+                    zoomX = mouseX;
+                    zoomY = mouseY;
+                } else if (viewport.pixelSize * factor >= MIN_PIXEL_SPACING) {
+                    viewport.zoomAt(mouseX, mouseY, factor);
+                    std::cout << "Pixel size " << viewport.pixelSize << " ("
+                              << precisionName(framePrecision(viewport)) << ")" << std::endl;
+                    drawMandelbrot(1000);
+                }
+                break;
+            }
+            case SDL_MOUSEMOTION:
+                // Tiles under the cursor are rendered first in cursor-first order
+                scheduler.setFocus(event.motion.x, event.motion.y);
+                // Aim the next-zoom speculation at the new cursor tile
+                if (event.motion.x / TILE_SIZE != speculationTileX ||
+                    event.motion.y / TILE_SIZE != speculationTileY) {
+                    if (frameGeneration >= 0 && frameTilesDone == scheduler.tileCount(frameGeneration)) {
+                        requestSpeculation();
+                    }
+                }
+                break;
+            case SDL_MOUSEBUTTONDOWN:
+                if (event.button.button == SDL_BUTTON_LEFT) {
+                    panX = (event.button.x > WIDTH / 2) - (event.button.x < WIDTH / 2);
+                    panY = (event.button.y > HEIGHT / 2) - (event.button.y < HEIGHT / 2);
+                    viewport.centerOn(event.button.x, event.button.y);
+                    scheduler.setFocus(WIDTH / 2, HEIGHT / 2);
+                    drawMandelbrot(1000);
+                }
+                break;
         }
     }
 };
 
+// Function to run the benchmark zoom without a window, through the tile
+// scheduler and colorizer the way frames are drawn on screen
+// Usage: --bench [frames]
+int runHeadlessBench(int frames) {
+    TileScheduler scheduler;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool woken = false;
+    scheduler.setWakeCallback([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        woken = true;
+        ready.notify_one();
+    });
+    scheduler.start(0);
+    
+    FractalParams params;
+    std::vector<Uint32> pixels(WIDTH * HEIGHT);
+    double best = 0.0;
+    for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+        Viewport view(WIDTH, HEIGHT);
+        view.centerReal = BENCH_CENTER_REAL;
+        view.centerImag = BENCH_CENTER_IMAG;
+        view.pixelSize = 3.0 / HEIGHT;
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; ++frame) {
+            int generation = scheduler.submit(view, params, BENCH_ITERATIONS, choosePrecision(view, params));
+            const int* iterations = scheduler.iterations(generation);
+            int remaining = scheduler.tileCount(generation);
+            while (remaining > 0) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&] { return woken; });
+                    woken = false;
+                }
+                const TileTask* task;
+                while (remaining > 0 && (task = scheduler.popCompleted()) != nullptr) {
+                    const TileRect& r = task->rect;
+                    for (int y = r.y0; y < r.y1; ++y) {
+                        mandel_colorize(&iterations[y * WIDTH + r.x0], r.x1 - r.x0, BENCH_ITERATIONS,
+                                        MANDEL_PALETTE_BANDS, &pixels[y * WIDTH + r.x0]);
+                    }
+                    remaining--;
+                }
+            }
+            view.pixelSize *= BENCH_ZOOM;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = pass == 0 ? ms : std::min(best, ms);
+    }
+    std::printf("Bench: %d frames on %d threads, best of %d passes: %.2f ms per frame\n", frames,
+                scheduler.threadCount(), BENCH_PASSES, best / frames);
+    scheduler.stop();
+    return 0;
+}
+
+// Function to time the image encoders on one colorized frame: throughput in
+// MB/s of RGB input, and the size of the file
+// Usage: --bench-encode [width height]
+int runEncoderBench(int argc, char* argv[]) {
+    int width = argc > 3 ? std::atoi(argv[2]) : 1920;
+    int height = argc > 3 ? std::atoi(argv[3]) : 1080;
+    
+    Viewport view(width, height);
+    view.centerReal = BENCH_CENTER_REAL;
+    view.centerImag = BENCH_CENTER_IMAG;
+    view.pixelSize = ENCODE_PIXEL_SIZE;
+    FractalParams params;
+    FrameKernel kernel;
+    kernel.prepare(view, params, BENCH_ITERATIONS, choosePrecision(view, params));
+    std::vector<int> iterations(static_cast<size_t>(width) * height);
+    kernel.renderRect(0, 0, width, height, iterations.data(), width, nullptr);
+    std::vector<Uint32> image(iterations.size());
+    mandel_colorize(iterations.data(), width * height, BENCH_ITERATIONS, MANDEL_PALETTE_BANDS, image.data());
+    
+    // At least two strips, so the parallel path runs even on one core
+    int threads = std::max(2u, std::thread::hardware_concurrency());
+    std::vector<Uint8> bmp(static_cast<size_t>(width) * height * 4 + 1024);
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(image.data(), width, height, 32,
+                                                              width * sizeof(Uint32),
+                                                              SDL_PIXELFORMAT_ARGB8888);
+    double rgbBytes = static_cast<double>(width) * height * 3;
+    std::printf("%dx%d frame, %.1f MB of RGB\n", width, height, rgbBytes / 1e6);
+    std::printf("%-14s %10s %10s %10s %8s\n", "format", "ms", "MB/s", "KB", "ratio");
+    for (int format = 0; format < 4; ++format) {
+        char name[32];
+        double best = 0.0;
+        size_t size = 0;
+        for (int r = 0; r < ENCODE_REPEATS; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            if (format == 0) {
+                std::snprintf(name, sizeof(name), "bmp (SDL)");
+                SDL_RWops* stream = SDL_RWFromMem(bmp.data(), static_cast<int>(bmp.size()));
+                SDL_SaveBMP_RW(surface, stream, 0);
+                size = static_cast<size_t>(SDL_RWtell(stream));
+                SDL_RWclose(stream);
+            } else if (format == 1) {
+                std::snprintf(name, sizeof(name), "qoi");
+                size = encodeQoi(image.data(), width, height, width).size();
+            } else if (format == 2) {
+                std::snprintf(name, sizeof(name), "png");
+                size = encodePng(image.data(), width, height, width).size();
+            } else {
+                std::snprintf(name, sizeof(name), "png x%d strips", threads);
+                size = encodePngParallel(image.data(), width, height, width, threads).size();
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = r == 0 ? ms : std::min(best, ms);
+        }
+        std::printf("%-14s %10.2f %10.1f %10.1f %7.2fx\n", name, best, rgbBytes / 1e3 / best, size / 1024.0,
+                    rgbBytes / size);
+    }
+    SDL_FreeSurface(surface);
+    return 0;
+}
+
+// Function to render a high-resolution Buddhabrot straight to a BMP file
+// Usage: --buddhabrot <file.bmp> [width height samples]
+int renderBuddhabrotFile(int argc, char* argv[]) {
+    const char* path = argv[2];
+    int width = argc > 4 ? std::atoi(argv[3]) : 1920;
+    int height = argc > 4 ? std::atoi(argv[4]) : 1440;
+    
+    BuddhabrotSettings settings;
+    if (argc > 5) {
+        settings.samples = std::atoll(argv[5]);
+    }
+    
+    Viewport view(width, height);
+    std::vector<Uint32> image(static_cast<size_t>(width) * height);
+    
+    std::cout << "Rendering " << width << "x" << height << " Buddhabrot with "
+              << settings.samples << " samples..." << std::endl;
+    Buddhabrot buddhabrot(view, settings);
+    buddhabrot.render();
+    buddhabrot.toPixels(image.data());
+    
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(image.data(), width, height, 32,
+                                                              width * sizeof(Uint32),
+                                                              SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr || SDL_SaveBMP(surface, path) != 0) {
+        std::cerr << "Unable to save " << path << ": " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(surface);
+        return 1;
+    }
+    SDL_FreeSurface(surface);
+    
+    std::cout << "Saved " << path << std::endl;
+    return 0;
+}
+
+// Function to count the pixels where a farm render differs from the same
+// tiles rendered in this process
+long long checkFarmRender(const RenderFarm& farm, const Viewport& view, const FractalParams& params,
+                          int maxIterations) {
+    FrameKernel kernel;
+    kernel.prepare(view, params, maxIterations, choosePrecision(view, params));
+    std::vector<int> expected(static_cast<size_t>(view.width) * view.height);
+    std::vector<TileTask> tiles = makeTiles(view.width, view.height, 0);
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const TileRect& r = tiles[i].rect;
+        kernel.renderRect(r.x0, r.y0, r.x1, r.y1, &expected[static_cast<size_t>(r.y0) * view.width + r.x0],
+                          view.width, nullptr);
+    }
+    long long differing = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        differing += farm.iterations()[i] != expected[i] ? 1 : 0;
+    }
+    return differing;
+}
+
+// Function to render a large image of the set on worker processes straight
+// to a BMP file. With "crash N" the first worker exits after N tiles, and
+// the frame is checked bit for bit against a render in this process.
+// Usage: --farm <file.bmp> [width height workers [crash N]]
+int renderFarmFile(int argc, char* argv[]) {
+    const char* path = argv[2];
+    int width = argc > 4 ? std::atoi(argv[3]) : 7680;
+    int height = argc > 4 ? std::atoi(argv[4]) : 4320;
+    
+    FarmSettings settings;
+    if (argc > 5) {
+        settings.workers = std::atoi(argv[5]);
+    }
+    if (argc > 7 && std::strcmp(argv[6], "crash") == 0) {
+        settings.crashAfterTiles = std::max(0, std::atoi(argv[7]));
+    }
+    
+    Viewport view(width, height);
+    FractalParams params;
+    const int maxIterations = 1000;
+    
+    std::cout << "Rendering " << width << "x" << height << " on worker processes..." << std::endl;
+    RenderFarm farm(settings);
+    if (!farm.render(view, params, maxIterations, choosePrecision(view, params))) {
+        std::cerr << "Render farm failed: " << farm.error() << std::endl;
+        return 1;
+    }
+    const FarmStats& stats = farm.stats();
+    std::cout << "Rendered " << stats.tiles << " tiles on " << stats.workers << " worker processes in "
+              << static_cast<int>(stats.seconds * 1000.0) << " ms";
+    if (stats.crashes > 0) {
+        std::cout << " (" << stats.crashes << " workers lost, " << stats.reassigned << " tiles reassigned)";
+    }
+    std::cout << std::endl;
+    
+    if (settings.crashAfterTiles >= 0) {
+        if (stats.crashes == 0) {
+            std::cerr << "Crash check failed: no worker was lost" << std::endl;
+            return 1;
+        }
+        long long differing = checkFarmRender(farm, view, params, maxIterations);
+        if (differing > 0) {
+            std::cerr << "Crash check failed: " << differing << " pixels differ from a single-process render"
+                      << std::endl;
+            return 1;
+        }
+        std::cout << "Crash check passed: identical to a single-process render" << std::endl;
+    }
+    
+    std::vector<Uint32> image(static_cast<size_t>(width) * height);
+    mandel_colorize(farm.iterations(), width * height, maxIterations, MANDEL_PALETTE_BANDS, image.data());
+    
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(image.data(), width, height, 32,
+                                                              width * sizeof(Uint32),
+                                                              SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr || SDL_SaveBMP(surface, path) != 0) {
+        std::cerr << "Unable to save " << path << ": " << SDL_GetError() << std::endl;
+        SDL_FreeSurface(surface);
+        return 1;
+    }
+    SDL_FreeSurface(surface);
+    
+    std::cout << "Saved " << path << std::endl;
+    return 0;
+}
+
+// Function to render the frames of a keyframed zoom to numbered PNG files
+// Usage: --zoom-path <keyframes.txt> <output_prefix> [width height reproject_scale]
+int renderZoomPath(int argc, char* argv[]) {
+    std::vector<ZoomKeyframe> keyframes;
+    if (!loadZoomPath(argv[2], keyframes)) {
+        std::cerr << "Unable to read keyframes from " << argv[2] << std::endl;
+        return 1;
+    }
+    ZoomSettings settings;
+    settings.prefix = argv[3];
+    if (argc > 5) {
+        settings.width = std::atoi(argv[4]);
+        settings.height = std::atoi(argv[5]);
+    }
+    if (argc > 6) {
+        settings.reprojectScale = std::atoi(argv[6]);
+    }
+    
+    std::cout << "Rendering " << keyframes.back().frame + 1 << " frames of " << settings.width << "x"
+              << settings.height << " to " << settings.prefix << "*.png..." << std::endl;
+    ZoomSequence sequence(settings);
+    ZoomStats stats = sequence.run(keyframes);
+    if (stats.writeFailed) {
+        std::cerr << "Unable to write some frames to " << settings.prefix << "*.png" << std::endl;
+        return 1;
+    }
+    
+    std::printf("%d frames in %.2f s (%.1f frames/s); busy: compute %.2f s, colorize %.2f s, encode %.2f s\n",
+                stats.frames, stats.seconds, stats.frames / stats.seconds, stats.computeSeconds,
+                stats.colorizeSeconds, stats.encodeSeconds);
+    if (settings.reprojectScale > 1) {
+        std::printf("Reprojection: %d key renders, %.1f%% of the shown pixels computed\n", stats.keyRenders,
+                    100.0 * stats.pixelsComputed / stats.pixelsShown);
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 2 && std::strcmp(argv[1], "--buddhabrot") == 0) {
+        return renderBuddhabrotFile(argc, argv);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--farm") == 0) {
+        return renderFarmFile(argc, argv);
+    }
+    if (argc > 3 && std::strcmp(argv[1], "--zoom-path") == 0) {
+        return renderZoomPath(argc, argv);
+    }
+    // Usage: --serve [port] answers /z/x/y.png map tiles on localhost
+    if (argc > 1 && std::strcmp(argv[1], "--serve") == 0) {
+        TileServer server(argc > 2 ? std::atoi(argv[2]) : TILE_SERVER_DEFAULT_PORT);
+        return server.run() ? 0 : 1;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench-encode") == 0) {
+        return runEncoderBench(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        int frames = argc > 2 ? std::atoi(argv[2]) : BENCH_FRAMES;
+        return runHeadlessBench(frames > 0 ? frames : BENCH_FRAMES);
+    }
+    
     MandelbrotRenderer app;
     
+    // Usage: --stats <file.csv> writes every frame's stage timings on exit
+    if (argc > 2 && std::strcmp(argv[1], "--stats") == 0) {
+        app.setStatsPath(argv[2]);
+    }
+    
+    // Usage: --tune measures the kernels again instead of loading the saved tuning
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--tune") == 0) {
+            app.setRetune(true);
+        }
+    }
+    
     if (!app.initialize()) {
         std::cerr << "Failed to initialize application!" << std::endl;
         return 1;
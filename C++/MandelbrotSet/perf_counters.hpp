@@ -0,0 +1,171 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware performance counters of the calling thread, read through Linux
+// perf_event_open. Only user-space events are counted, which the default
+// perf_event_paranoid setting (2) allows. Every counter is opened on its own,
+// so one the CPU (or VM) lacks only drops that counter; if none can be
+// opened, or this is not Linux, reason() says why and every value reads as
+// unavailable. When the PMU has too few registers the kernel multiplexes
+// the counters, and values are scaled up by enabled/running time.
+
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+const char* const PERF_COUNTER_NAMES[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "branch_misses", "l1d_read_misses", "llc_misses"
+};
+
+// Counts over one measured span; valid[c] is false if counter c was not read
+struct PerfSample {
+    double values[PERF_COUNTER_COUNT];
+    bool valid[PERF_COUNTER_COUNT];
+
+    PerfSample() {
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            values[c] = 0.0;
+            valid[c] = false;
+        }
+    }
+
+    // Instructions per cycle, or 0 if either is missing
+    double ipc() const {
+        if (!valid[PERF_CYCLES] || !valid[PERF_INSTRUCTIONS] || values[PERF_CYCLES] <= 0.0) {
+            return 0.0;
+        }
+        return values[PERF_INSTRUCTIONS] / values[PERF_CYCLES];
+    }
+};
+
+class PerfCounters {
+private:
+    int fds[PERF_COUNTER_COUNT];
+    std::string failure;
+
+#if defined(__linux__)
+    static int openCounter(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+public:
+    PerfCounters() {
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            fds[c] = -1;
+        }
+#if defined(__linux__)
+        const uint32_t types[PERF_COUNTER_COUNT] = {
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+        };
+        const uint64_t configs[PERF_COUNTER_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+            PERF_COUNT_HW_CACHE_MISSES
+        };
+        int opened = 0;
+        int error = 0;
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            fds[c] = openCounter(types[c], configs[c]);
+            if (fds[c] >= 0) {
+                opened++;
+            } else if (error == 0) {
+                error = errno;
+            }
+        }
+        if (opened == 0) {
+            failure = std::string("perf_event_open: ") + std::strerror(error);
+            if (error == EACCES || error == EPERM) {
+                failure += " (see /proc/sys/kernel/perf_event_paranoid)";
+            } else if (error == ENOENT || error == EOPNOTSUPP) {
+                failure += " (no hardware counters on this CPU or VM)";
+            }
+        }
+#else
+        failure = "perf_event_open needs Linux";
+#endif
+    }
+
+    ~PerfCounters() {
+#if defined(__linux__)
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            if (fds[c] >= 0) {
+                close(fds[c]);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return failure.empty(); }
+
+    // Why no counter could be opened, or "" if any could
+    const std::string& reason() const { return failure; }
+
+    // Function to zero the counters and start counting
+    void start() {
+#if defined(__linux__)
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            if (fds[c] >= 0) {
+                ioctl(fds[c], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Function to stop counting and read what was counted since start()
+    PerfSample stop() {
+        PerfSample sample;
+#if defined(__linux__)
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            if (fds[c] >= 0) {
+                ioctl(fds[c], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        for (int c = 0; c < PERF_COUNTER_COUNT; ++c) {
+            // value, time enabled, time running
+            uint64_t data[3];
+            if (fds[c] < 0 || read(fds[c], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) ||
+                data[2] == 0) {
+                continue;
+            }
+            sample.values[c] = static_cast<double>(data[0]) * data[1] / data[2];
+            sample.valid[c] = true;
+        }
+#endif
+        return sample;
+    }
+};
+
+#endif
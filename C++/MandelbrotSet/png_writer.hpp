@@ -0,0 +1,434 @@
+#ifndef PNG_WRITER_HPP
+#define PNG_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Self-contained PNG encoder for ARGB8888 frames (written as 8-bit RGB).
+//
+// Each row gets the PNG filter with the smallest sum of absolute
+// differences, and the filtered rows are compressed with a fast deflate:
+// LZ77 over a hash chain of limited depth, coded with the fixed Huffman
+// tables, so no code tables need to be built or sent. The fractal's flat
+// color bands compress well this way; a full zlib would save another
+// 10-20% for several times the time.
+//
+// encodePngParallel() deflates horizontal strips of the image on several
+// threads. Each strip is filtered against the last row of the strip above
+// and ends on a byte boundary (an empty stored block, like zlib's
+// Z_SYNC_FLUSH), so the strips are concatenated into one zlib stream; their
+// Adler-32 checksums are combined without reading the data again.
+
+// Hash chain steps tried per position; more finds longer matches, slower
+const int DEFLATE_CHAIN_DEPTH = 16;
+
+const int DEFLATE_WINDOW = 32768;
+const int DEFLATE_MIN_MATCH = 3;
+const int DEFLATE_MAX_MATCH = 258;
+const int DEFLATE_HASH_BITS = 15;
+
+// Fewest rows per strip of the parallel encoder; matches cannot reach
+// across strips, so thinner strips compress worse
+const int PNG_MIN_STRIP_ROWS = 32;
+
+namespace detail {
+
+struct Crc32Table {
+    uint32_t entries[256];
+
+    Crc32Table() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+} // namespace detail
+
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t size) {
+    static const detail::Crc32Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline uint32_t adler32Update(uint32_t adler, const uint8_t* data, size_t size) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        // Largest run before the sums can overflow 32 bits
+        size_t run = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return b << 16 | a;
+}
+
+// Function to combine the Adler-32 of two blocks of data, given the second
+// block's length (as zlib's adler32_combine)
+inline uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t length2) {
+    const uint32_t base = 65521;
+    uint32_t remainder = static_cast<uint32_t>(length2 % base);
+    uint32_t sum1 = adler1 & 0xFFFF;
+    uint32_t sum2 = remainder * sum1 % base;
+    sum1 += (adler2 & 0xFFFF) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+    if (sum1 >= base) {
+        sum1 -= base;
+    }
+    if (sum1 >= base) {
+        sum1 -= base;
+    }
+    if (sum2 >= base * 2) {
+        sum2 -= base * 2;
+    }
+    if (sum2 >= base) {
+        sum2 -= base;
+    }
+    return sum2 << 16 | sum1;
+}
+
+// Deflate output, least significant bit first
+class BitWriter {
+private:
+    std::vector<uint8_t>& out;
+    uint32_t bits;
+    int count;
+
+public:
+    BitWriter(std::vector<uint8_t>& output) : out(output), bits(0), count(0) {}
+
+    void put(uint32_t value, int length) {
+        bits |= value << count;
+        count += length;
+        while (count >= 8) {
+            out.push_back(static_cast<uint8_t>(bits));
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void putCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) {
+            reversed = reversed << 1 | (code >> i & 1);
+        }
+        put(reversed, length);
+    }
+
+    // Function to pad to a byte boundary
+    void flush() {
+        if (count > 0) {
+            out.push_back(static_cast<uint8_t>(bits));
+        }
+        bits = 0;
+        count = 0;
+    }
+};
+
+namespace detail {
+
+const uint16_t DEFLATE_LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                           35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t DEFLATE_LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                           3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DEFLATE_DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                             193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                             6145, 8193, 12289, 16385, 24577 };
+const uint8_t DEFLATE_DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                             6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Function to write a literal/length symbol with the fixed Huffman code
+inline void putFixedSymbol(BitWriter& writer, int symbol) {
+    if (symbol < 144) {
+        writer.putCode(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.putCode(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.putCode(symbol - 256, 7);
+    } else {
+        writer.putCode(0xC0 + symbol - 280, 8);
+    }
+}
+
+inline void putMatch(BitWriter& writer, int length, int distance) {
+    int l = 28;
+    while (DEFLATE_LENGTH_BASE[l] > length) {
+        l--;
+    }
+    putFixedSymbol(writer, 257 + l);
+    writer.put(length - DEFLATE_LENGTH_BASE[l], DEFLATE_LENGTH_EXTRA[l]);
+    int d = 29;
+    while (DEFLATE_DISTANCE_BASE[d] > distance) {
+        d--;
+    }
+    writer.putCode(d, 5);
+    writer.put(distance - DEFLATE_DISTANCE_BASE[d], DEFLATE_DISTANCE_EXTRA[d]);
+}
+
+inline uint32_t hash3(const uint8_t* p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+} // namespace detail
+
+// Function to compress data as one fixed-Huffman deflate block; final marks
+// the last block of the stream
+inline void deflateFixed(const uint8_t* data, size_t size, bool final, BitWriter& writer) {
+    writer.put(final ? 1 : 0, 1);
+    writer.put(1, 2);
+
+    std::vector<int32_t> head(static_cast<size_t>(1) << DEFLATE_HASH_BITS, -1);
+    std::vector<int32_t> previous(DEFLATE_WINDOW, -1);
+    size_t i = 0;
+    while (i < size) {
+        int bestLength = 0;
+        int bestDistance = 0;
+        if (i + DEFLATE_MIN_MATCH <= size) {
+            uint32_t h = detail::hash3(&data[i]);
+            int maxLength = static_cast<int>(std::min<size_t>(DEFLATE_MAX_MATCH, size - i));
+            int32_t candidate = head[h];
+            for (int step = 0; step < DEFLATE_CHAIN_DEPTH && candidate >= 0; ++step) {
+                size_t distance = i - candidate;
+                if (distance > static_cast<size_t>(DEFLATE_WINDOW)) {
+                    break;
+                }
+                const uint8_t* a = &data[candidate];
+                const uint8_t* b = &data[i];
+                int length = 0;
+                while (length < maxLength && a[length] == b[length]) {
+                    length++;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = static_cast<int>(distance);
+                    if (length == maxLength) {
+                        break;
+                    }
+                }
+                candidate = previous[candidate % DEFLATE_WINDOW];
+            }
+        }
+
+        size_t advance = bestLength >= DEFLATE_MIN_MATCH ? bestLength : 1;
+        if (advance > 1) {
+            detail::putMatch(writer, bestLength, bestDistance);
+        } else {
+            detail::putFixedSymbol(writer, data[i]);
+        }
+        // Every position covered goes into the chains
+        for (size_t end = i + advance; i < end; ++i) {
+            if (i + DEFLATE_MIN_MATCH <= size) {
+                uint32_t h = detail::hash3(&data[i]);
+                previous[i % DEFLATE_WINDOW] = head[h];
+                head[h] = static_cast<int32_t>(i);
+            }
+        }
+    }
+    detail::putFixedSymbol(writer, 256);
+}
+
+// Function to filter rows y0..y1 of an ARGB8888 frame into PNG scanlines
+// (a filter byte, then RGB), appended to out
+inline void pngFilterRows(const uint32_t* argb, int width, int stride, int y0, int y1, std::vector<uint8_t>& out) {
+    size_t rowBytes = static_cast<size_t>(width) * 3;
+    std::vector<uint8_t> above(rowBytes, 0);
+    std::vector<uint8_t> current(rowBytes);
+    std::vector<uint8_t> candidate(rowBytes);
+    std::vector<uint8_t> best(rowBytes);
+    if (y0 > 0) {
+        const uint32_t* row = argb + static_cast<size_t>(y0 - 1) * stride;
+        for (int x = 0; x < width; ++x) {
+            above[x * 3] = static_cast<uint8_t>(row[x] >> 16);
+            above[x * 3 + 1] = static_cast<uint8_t>(row[x] >> 8);
+            above[x * 3 + 2] = static_cast<uint8_t>(row[x]);
+        }
+    }
+    for (int y = y0; y < y1; ++y) {
+        const uint32_t* row = argb + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < width; ++x) {
+            current[x * 3] = static_cast<uint8_t>(row[x] >> 16);
+            current[x * 3 + 1] = static_cast<uint8_t>(row[x] >> 8);
+            current[x * 3 + 2] = static_cast<uint8_t>(row[x]);
+        }
+
+        // None, Sub, Up, Average, Paeth: keep the one with the smallest
+        // sum of absolute (signed) residuals
+        int bestFilter = 0;
+        long bestCost = -1;
+        for (int filter = 0; filter < 5; ++filter) {
+            long cost = 0;
+            for (size_t i = 0; i < rowBytes; ++i) {
+                int left = i >= 3 ? current[i - 3] : 0;
+                int up = above[i];
+                int upLeft = i >= 3 ? above[i - 3] : 0;
+                int predicted = filter == 0 ? 0 : filter == 1 ? left : filter == 2 ? up
+                                : filter == 3 ? (left + up) / 2 : detail::paeth(left, up, upLeft);
+                uint8_t residual = static_cast<uint8_t>(current[i] - predicted);
+                candidate[i] = residual;
+                cost += residual < 128 ? residual : 256 - residual;
+            }
+            if (bestCost < 0 || cost < bestCost) {
+                bestCost = cost;
+                bestFilter = filter;
+                best.swap(candidate);
+            }
+        }
+        out.push_back(static_cast<uint8_t>(bestFilter));
+        out.insert(out.end(), best.begin(), best.end());
+        above.swap(current);
+    }
+}
+
+namespace detail {
+
+inline void putBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void putChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data) {
+    putBigEndian(png, static_cast<uint32_t>(data.size()));
+    size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+    putBigEndian(png, crc32Update(0, &png[start], png.size() - start));
+}
+
+} // namespace detail
+
+// Function to wrap a zlib stream (IDAT data) into a complete PNG file
+inline std::vector<uint8_t> pngContainer(int width, int height, const std::vector<uint8_t>& zlib) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    std::vector<uint8_t> png(signature, signature + 8);
+    std::vector<uint8_t> header;
+    detail::putBigEndian(header, static_cast<uint32_t>(width));
+    detail::putBigEndian(header, static_cast<uint32_t>(height));
+    header.push_back(8); // bits per channel
+    header.push_back(2); // RGB
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    detail::putChunk(png, "IHDR", header);
+    detail::putChunk(png, "IDAT", zlib);
+    detail::putChunk(png, "IEND", std::vector<uint8_t>());
+    return png;
+}
+
+// Function to encode an ARGB8888 frame as a PNG file in memory
+inline std::vector<uint8_t> encodePng(const uint32_t* argb, int width, int height, int stride) {
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((static_cast<size_t>(width) * 3 + 1) * height);
+    pngFilterRows(argb, width, stride, 0, height, scanlines);
+
+    // zlib header: deflate, 32K window, fastest compression
+    std::vector<uint8_t> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    BitWriter writer(zlib);
+    deflateFixed(scanlines.data(), scanlines.size(), true, writer);
+    writer.flush();
+    detail::putBigEndian(zlib, adler32Update(1, scanlines.data(), scanlines.size()));
+    return pngContainer(width, height, zlib);
+}
+
+// Function to encode an ARGB8888 frame as a PNG file in memory, deflating
+// horizontal strips on up to threads threads
+inline std::vector<uint8_t> encodePngParallel(const uint32_t* argb, int width, int height, int stride,
+                                              int threads) {
+    int strips = std::min(threads, height / PNG_MIN_STRIP_ROWS);
+    if (strips <= 1) {
+        return encodePng(argb, width, height, stride);
+    }
+
+    struct Strip {
+        std::vector<uint8_t> deflated;
+        uint32_t adler;
+        size_t length;
+    };
+    std::vector<Strip> parts(strips);
+    auto encodeStrip = [&](int s) {
+        int y0 = static_cast<int>(static_cast<long long>(height) * s / strips);
+        int y1 = static_cast<int>(static_cast<long long>(height) * (s + 1) / strips);
+        std::vector<uint8_t> scanlines;
+        scanlines.reserve((static_cast<size_t>(width) * 3 + 1) * (y1 - y0));
+        pngFilterRows(argb, width, stride, y0, y1, scanlines);
+
+        Strip& part = parts[s];
+        BitWriter writer(part.deflated);
+        bool last = s == strips - 1;
+        deflateFixed(scanlines.data(), scanlines.size(), last, writer);
+        if (!last) {
+            // Empty stored block: pads to a byte boundary for the next strip
+            writer.put(0, 3);
+            writer.flush();
+            static const uint8_t emptyLength[4] = { 0x00, 0x00, 0xFF, 0xFF };
+            part.deflated.insert(part.deflated.end(), emptyLength, emptyLength + 4);
+        }
+        writer.flush();
+        part.adler = adler32Update(1, scanlines.data(), scanlines.size());
+        part.length = scanlines.size();
+    };
+
+    std::vector<std::thread> workers;
+    for (int s = 1; s < strips; ++s) {
+        workers.push_back(std::thread(encodeStrip, s));
+    }
+    encodeStrip(0);
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+    }
+
+    std::vector<uint8_t> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    uint32_t adler = 1;
+    for (int s = 0; s < strips; ++s) {
+        zlib.insert(zlib.end(), parts[s].deflated.begin(), parts[s].deflated.end());
+        adler = adler32Combine(adler, parts[s].adler, parts[s].length);
+    }
+    detail::putBigEndian(zlib, adler);
+    return pngContainer(width, height, zlib);
+}
+
+// Function to write a frame to a PNG file, encoded on up to threads
+// threads. Returns false on failure.
+inline bool savePng(const char* path, const uint32_t* argb, int width, int height, int stride,
+                    int threads = 1) {
+    std::vector<uint8_t> png = encodePngParallel(argb, width, height, stride, threads);
+    FILE* file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = std::fwrite(png.data(), 1, png.size(), file) == png.size();
+    return std::fclose(file) == 0 && written;
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef QOI_WRITER_HPP
+#define QOI_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// QOI ("Quite OK Image") encoder for ARGB8888 frames, written as 8-bit RGB.
+//
+// One pass over the pixels, each coded as a run of the previous pixel, an
+// index into the 64 most recently seen colors, a small difference from the
+// previous pixel, or the full color. Several times faster than PNG for a
+// somewhat larger file; useful where encoding time matters more than size.
+
+const int QOI_RUN_MAX = 62;
+
+namespace detail {
+
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xC0;
+const uint8_t QOI_OP_RGB = 0xFE;
+
+inline void putQoiBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Slot of a color in the index (alpha is always 255)
+inline int qoiHash(uint32_t rgb) {
+    return ((rgb >> 16 & 0xFF) * 3 + (rgb >> 8 & 0xFF) * 5 + (rgb & 0xFF) * 7 + 255 * 11) % 64;
+}
+
+} // namespace detail
+
+// Function to encode an ARGB8888 frame as a QOI file in memory
+inline std::vector<uint8_t> encodeQoi(const uint32_t* argb, int width, int height, int stride) {
+    std::vector<uint8_t> out;
+    out.reserve(static_cast<size_t>(width) * height + 22);
+    out.push_back('q');
+    out.push_back('o');
+    out.push_back('i');
+    out.push_back('f');
+    detail::putQoiBigEndian(out, static_cast<uint32_t>(width));
+    detail::putQoiBigEndian(out, static_cast<uint32_t>(height));
+    out.push_back(3); // RGB
+    out.push_back(0); // sRGB
+
+    // The decoder's index starts out transparent black, which no pixel here
+    // matches; 0xFFFFFFFF stands for that
+    uint32_t index[64];
+    std::fill(index, index + 64, 0xFFFFFFFFu);
+    uint32_t previous = 0;
+    int run = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint32_t* row = argb + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < width; ++x) {
+            uint32_t pixel = row[x] & 0xFFFFFF;
+            if (pixel == previous) {
+                if (++run == QOI_RUN_MAX) {
+                    out.push_back(static_cast<uint8_t>(detail::QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back(static_cast<uint8_t>(detail::QOI_OP_RUN | (run - 1)));
+                run = 0;
+            }
+
+            int slot = detail::qoiHash(pixel);
+            if (index[slot] == pixel) {
+                out.push_back(static_cast<uint8_t>(detail::QOI_OP_INDEX | slot));
+            } else {
+                index[slot] = pixel;
+                // Channel differences wrap around, as the decoder adds them mod 256
+                int dr = static_cast<int8_t>((pixel >> 16) - (previous >> 16));
+                int dg = static_cast<int8_t>((pixel >> 8) - (previous >> 8));
+                int db = static_cast<int8_t>(pixel - previous);
+                int drg = dr - dg;
+                int dbg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(static_cast<uint8_t>(detail::QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+                                                       (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                    out.push_back(static_cast<uint8_t>(detail::QOI_OP_LUMA | (dg + 32)));
+                    out.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+                } else {
+                    out.push_back(detail::QOI_OP_RGB);
+                    out.push_back(static_cast<uint8_t>(pixel >> 16));
+                    out.push_back(static_cast<uint8_t>(pixel >> 8));
+                    out.push_back(static_cast<uint8_t>(pixel));
+                }
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        out.push_back(static_cast<uint8_t>(detail::QOI_OP_RUN | (run - 1)));
+    }
+
+    static const uint8_t endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out.insert(out.end(), endMarker, endMarker + 8);
+    return out;
+}
+
+// Function to write a frame to a QOI file. Returns false on failure.
+inline bool saveQoi(const char* path, const uint32_t* argb, int width, int height, int stride) {
+    std::vector<uint8_t> qoi = encodeQoi(argb, width, height, stride);
+    FILE* file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool written = std::fwrite(qoi.data(), 1, qoi.size(), file) == qoi.size();
+    return std::fclose(file) == 0 && written;
+}
+
+#endif
@@ -0,0 +1,454 @@
+#ifndef TILE_SERVER_HPP
+#define TILE_SERVER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TILE_SERVER_SUPPORTED 1
+#include <cerrno>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#else
+#define TILE_SERVER_SUPPORTED 0
+#endif
+
+#include "fractal.hpp"
+#include "mandel.h"
+#include "png_writer.hpp"
+#include "precision.hpp"
+#include "tile_cache.hpp"
+
+// HTTP server for slippy-map tiles: GET /z/x/y.png on localhost, for
+// Leaflet and the like (GET / serves a Leaflet page, GET /stats counters).
+//
+// Zoom level z covers the square [-2.5, 1.5] x [-2, 2] with 2^z x 2^z
+// tiles of MAP_TILE_SIZE pixels. The requesting thread looks the tile up
+// in the tile cache; a hit goes straight to the encoder threads, and only
+// a miss goes to the compute threads, which render it and add it to the
+// cache. Colorizing and PNG encoding run on the encoder threads, so
+// compute threads only ever render, and cached tiles never queue behind
+// renders.
+//
+// Requests for a tile that is already queued or rendering join that job
+// instead of starting another (coalescing). While a request waits, its
+// connection is checked for a hang-up; once every request of a job has
+// been abandoned, the job is dropped at the next hand-over between
+// threads. A tile that is being rendered is finished and cached.
+//
+// Each connection is served by its own thread, with HTTP/1.1 keep-alive.
+
+const int MAP_TILE_SIZE = 256;
+const int MAP_MAX_ZOOM = 22;
+const int MAP_ITERATIONS = 1000;
+
+// How often a waiting request checks whether its client is still there
+const int ABANDON_CHECK_MS = 20;
+
+const int TILE_SERVER_DEFAULT_PORT = 8080;
+
+const char* const TILE_SERVER_PAGE =
+    "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Mandelbrot</title>\n"
+    "<link rel=\"stylesheet\" href=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.css\">\n"
+    "<script src=\"https://unpkg.com/leaflet@1.9.4/dist/leaflet.js\"></script>\n"
+    "<style>html, body, #map { height: 100%; margin: 0; background: #000; }</style></head>\n"
+    "<body><div id=\"map\"></div><script>\n"
+    "var map = L.map('map', { crs: L.CRS.Simple, minZoom: 0, maxZoom: 22 }).setView([-128, 128], 1);\n"
+    "L.tileLayer('/{z}/{x}/{y}.png', { tileSize: 256, noWrap: true, maxZoom: 22,\n"
+    "    bounds: [[-256, 0], [0, 256]] }).addTo(map);\n"
+    "</script></body></html>\n";
+
+struct TileServerStats {
+    long long requests;  // tile requests
+    long long coalesced; // joined a job already in flight
+    long long abandoned; // client went away while waiting
+    long long dropped;   // jobs dropped because every client went away
+    long long rendered;  // tiles rendered by the compute threads
+    long long cached;    // tiles taken from the tile cache
+    long long encoded;   // PNGs encoded
+
+    TileServerStats()
+        : requests(0), coalesced(0), abandoned(0), dropped(0), rendered(0), cached(0), encoded(0) {}
+};
+
+// One tile being produced, shared by every request waiting for it
+struct TileJob {
+    int zoom;
+    int x;
+    int y;
+    int waiters;
+    bool done;
+    std::vector<int> iterations;
+    std::shared_ptr<const std::vector<uint8_t> > png;
+
+    TileJob(int z, int tileX, int tileY) : zoom(z), x(tileX), y(tileY), waiters(1), done(false) {}
+};
+
+// Blocking queue of jobs between the thread pools
+class JobQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::shared_ptr<TileJob> > jobs;
+
+public:
+    void push(const std::shared_ptr<TileJob>& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        ready.notify_one();
+    }
+
+    std::shared_ptr<TileJob> pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !jobs.empty(); });
+        std::shared_ptr<TileJob> job = jobs.front();
+        jobs.pop_front();
+        return job;
+    }
+};
+
+// Function to get the view of one map tile
+inline Viewport mapTileView(int zoom, int x, int y) {
+    Viewport view(MAP_TILE_SIZE, MAP_TILE_SIZE);
+    view.pixelSize = 4.0 / (static_cast<double>(MAP_TILE_SIZE) * (1 << zoom));
+    view.centerReal = -2.5 + (x + 0.5) * MAP_TILE_SIZE * view.pixelSize;
+    view.centerImag = -2.0 + (y + 0.5) * MAP_TILE_SIZE * view.pixelSize;
+    return view;
+}
+
+class TileServer {
+private:
+    typedef std::tuple<int, int, int> TileKey;
+
+    int port;
+    FractalParams params;
+    TileCache cache;
+    JobQueue computeQueue;
+    JobQueue encodeQueue;
+
+    // Guards inFlight, every job's waiters/done/png and stats
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::map<TileKey, std::shared_ptr<TileJob> > inFlight;
+    TileServerStats stats;
+
+    // Function to drop a job nobody waits for any more; call with the lock
+    bool dropIfAbandoned(const std::shared_ptr<TileJob>& job) {
+        if (job->waiters > 0) {
+            return false;
+        }
+        inFlight.erase(TileKey(job->zoom, job->x, job->y));
+        stats.dropped++;
+        return true;
+    }
+
+    void computeLoop() {
+        for (;;) {
+            std::shared_ptr<TileJob> job = computeQueue.pop();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (dropIfAbandoned(job)) {
+                    continue;
+                }
+            }
+            Viewport view = mapTileView(job->zoom, job->x, job->y);
+            std::shared_ptr<CacheGroup> group =
+                cache.group(view, params, MAP_ITERATIONS, choosePrecision(view, params));
+            group->kernel.renderRect(0, 0, MAP_TILE_SIZE, MAP_TILE_SIZE, job->iterations.data(), MAP_TILE_SIZE,
+                                     nullptr);
+            for (int ty = 0; ty < MAP_TILE_SIZE / TILE_SIZE; ++ty) {
+                for (int tx = 0; tx < MAP_TILE_SIZE / TILE_SIZE; ++tx) {
+                    cache.insert(*group, tx, ty, &job->iterations[ty * TILE_SIZE * MAP_TILE_SIZE + tx * TILE_SIZE],
+                                 MAP_TILE_SIZE, false);
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.rendered++;
+            }
+            encodeQueue.push(job);
+        }
+    }
+
+    void encodeLoop() {
+        std::vector<uint32_t> pixels(MAP_TILE_SIZE * MAP_TILE_SIZE);
+        for (;;) {
+            std::shared_ptr<TileJob> job = encodeQueue.pop();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (dropIfAbandoned(job)) {
+                    continue;
+                }
+            }
+            mandel_colorize(job->iterations.data(), MAP_TILE_SIZE * MAP_TILE_SIZE, MAP_ITERATIONS,
+                            MANDEL_PALETTE_BANDS, pixels.data());
+            std::shared_ptr<const std::vector<uint8_t> > png =
+                std::make_shared<std::vector<uint8_t> >(encodePng(pixels.data(), MAP_TILE_SIZE, MAP_TILE_SIZE,
+                                                                  MAP_TILE_SIZE));
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job->png = png;
+                job->done = true;
+                inFlight.erase(TileKey(job->zoom, job->x, job->y));
+                stats.encoded++;
+            }
+            finished.notify_all();
+        }
+    }
+
+#if TILE_SERVER_SUPPORTED
+    static bool sendAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+#ifdef MSG_NOSIGNAL
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+            ssize_t sent = send(fd, bytes, size, 0);
+#endif
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    static bool respond(int fd, const char* status, const char* type, const void* body, size_t size,
+                        bool keepAlive, const char* extraHeaders = "") {
+        char header[512];
+        int length = std::snprintf(header, sizeof(header),
+                                   "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                                   "Access-Control-Allow-Origin: *\r\n%sConnection: %s\r\n\r\n",
+                                   status, type, size, extraHeaders, keepAlive ? "keep-alive" : "close");
+        return sendAll(fd, header, static_cast<size_t>(length)) && sendAll(fd, body, size);
+    }
+
+    // Function to tell whether the client closed its end while we waited.
+    // Pipelined bytes of its next request do not count.
+    static bool clientGone(int fd) {
+        pollfd entry = { fd, POLLIN, 0 };
+        if (poll(&entry, 1, 0) <= 0) {
+            return false;
+        }
+        if (entry.revents & (POLLHUP | POLLERR)) {
+            return true;
+        }
+        char byte;
+        return recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+    }
+
+    // Function to wait for a tile, joining a job in flight if there is one.
+    // Returns nullptr if the client went away first.
+    std::shared_ptr<const std::vector<uint8_t> > fetchTile(int fd, int zoom, int x, int y) {
+        std::shared_ptr<TileJob> job;
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.requests++;
+        TileKey key(zoom, x, y);
+        std::map<TileKey, std::shared_ptr<TileJob> >::iterator found = inFlight.find(key);
+        if (found != inFlight.end()) {
+            job = found->second;
+            job->waiters++;
+            stats.coalesced++;
+        } else {
+            job = std::make_shared<TileJob>(zoom, x, y);
+            inFlight[key] = job;
+            // Look the tile up without holding the lock; requests for it
+            // meanwhile join the job as usual
+            lock.unlock();
+            Viewport view = mapTileView(zoom, x, y);
+            TileRect whole = { 0, 0, MAP_TILE_SIZE, MAP_TILE_SIZE };
+            job->iterations.resize(MAP_TILE_SIZE * MAP_TILE_SIZE);
+            bool hit = cache.lookup(view, params, MAP_ITERATIONS, choosePrecision(view, params), whole,
+                                    job->iterations.data(), MAP_TILE_SIZE);
+            lock.lock();
+            if (hit) {
+                stats.cached++;
+                encodeQueue.push(job);
+            } else {
+                computeQueue.push(job);
+            }
+        }
+
+        while (!job->done) {
+            if (finished.wait_for(lock, std::chrono::milliseconds(ABANDON_CHECK_MS)) != std::cv_status::timeout) {
+                continue;
+            }
+            lock.unlock();
+            bool gone = clientGone(fd);
+            lock.lock();
+            if (gone && !job->done) {
+                job->waiters--;
+                stats.abandoned++;
+                return nullptr;
+            }
+        }
+        job->waiters--;
+        return job->png;
+    }
+
+    void serveConnection(int fd) {
+        std::string buffer;
+        char chunk[4096];
+        for (;;) {
+            size_t end;
+            while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+                if (got < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (got <= 0 || buffer.size() > 16384) {
+                    close(fd);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(got));
+            }
+            std::string request = buffer.substr(0, end);
+            buffer.erase(0, end + 4);
+
+            char method[8] = "";
+            char path[256] = "";
+            char version[16] = "";
+            std::sscanf(request.c_str(), "%7s %255s %15s", method, path, version);
+            bool keepAlive = std::strcmp(version, "HTTP/1.1") == 0 &&
+                             request.find("Connection: close") == std::string::npos &&
+                             request.find("connection: close") == std::string::npos;
+
+            bool sent;
+            int zoom, x, y, consumed = 0;
+            if (std::strcmp(method, "GET") != 0) {
+                sent = respond(fd, "405 Method Not Allowed", "text/plain", "GET only\n", 9, false);
+                keepAlive = false;
+            } else if (std::strcmp(path, "/") == 0) {
+                sent = respond(fd, "200 OK", "text/html", TILE_SERVER_PAGE, std::strlen(TILE_SERVER_PAGE), keepAlive);
+            } else if (std::strcmp(path, "/stats") == 0) {
+                std::string json = statsJson();
+                sent = respond(fd, "200 OK", "application/json", json.data(), json.size(), keepAlive,
+                               "Cache-Control: no-store\r\n");
+            } else if (std::sscanf(path, "/%d/%d/%d.png%n", &zoom, &x, &y, &consumed) == 3 &&
+                       path[consumed] == '\0' && zoom >= 0 && zoom <= MAP_MAX_ZOOM &&
+                       x >= 0 && y >= 0 && x < (1 << zoom) && y < (1 << zoom)) {
+                std::shared_ptr<const std::vector<uint8_t> > png = fetchTile(fd, zoom, x, y);
+                if (!png) {
+                    close(fd);
+                    return;
+                }
+                sent = respond(fd, "200 OK", "image/png", png->data(), png->size(), keepAlive,
+                               "Cache-Control: public, max-age=86400\r\n");
+            } else {
+                sent = respond(fd, "404 Not Found", "text/plain", "No such tile\n", 13, keepAlive);
+            }
+            if (!sent || !keepAlive) {
+                close(fd);
+                return;
+            }
+        }
+    }
+#endif
+
+public:
+    TileServer(int listenPort = TILE_SERVER_DEFAULT_PORT) : port(listenPort) {}
+
+    std::string statsJson() {
+        TileServerStats copy;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            copy = stats;
+        }
+        char json[512];
+        std::snprintf(json, sizeof(json),
+                      "{\"requests\":%lld,\"coalesced\":%lld,\"abandoned\":%lld,\"dropped\":%lld,"
+                      "\"rendered\":%lld,\"cached\":%lld,\"encoded\":%lld}\n",
+                      copy.requests, copy.coalesced, copy.abandoned, copy.dropped, copy.rendered,
+                      copy.cached, copy.encoded);
+        return json;
+    }
+
+    // Function to start the thread pools and serve until the process ends.
+    // Returns only if the listening socket cannot be set up.
+    bool run(int computeThreads = 0, int encodeThreads = 0) {
+#if TILE_SERVER_SUPPORTED
+        int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        if (computeThreads <= 0) {
+            computeThreads = hardware;
+        }
+        if (encodeThreads <= 0) {
+            encodeThreads = std::max(1, hardware / 4);
+        }
+
+        int listener = socket(AF_INET, SOCK_STREAM, 0);
+        if (listener < 0) {
+            std::perror("socket");
+            return false;
+        }
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in address;
+        std::memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(listener, 64) != 0) {
+            std::perror("bind");
+            close(listener);
+            return false;
+        }
+
+        for (int i = 0; i < computeThreads; ++i) {
+            std::thread(&TileServer::computeLoop, this).detach();
+        }
+        for (int i = 0; i < encodeThreads; ++i) {
+            std::thread(&TileServer::encodeLoop, this).detach();
+        }
+        std::printf("Serving tiles on http://127.0.0.1:%d/ (%d compute, %d encoder threads)\n", port,
+                    computeThreads, encodeThreads);
+        std::fflush(stdout);
+
+        for (;;) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno == EMFILE || errno == ENFILE) {
+                    // Out of descriptors until some connection closes
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    continue;
+                }
+                std::perror("accept");
+                close(listener);
+                return false;
+            }
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            std::thread(&TileServer::serveConnection, this, client).detach();
+        }
+#else
+        (void)computeThreads;
+        (void)encodeThreads;
+        std::fprintf(stderr, "The tile server needs POSIX sockets\n");
+        return false;
+#endif
+    }
+};
+
+#endif
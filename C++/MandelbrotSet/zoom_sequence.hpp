@@ -0,0 +1,394 @@
+#ifndef ZOOM_SEQUENCE_HPP
+#define ZOOM_SEQUENCE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "double_double.hpp"
+#include "fractal.hpp"
+#include "mandel.h"
+#include "png_writer.hpp"
+#include "precision.hpp"
+#include "tile_scheduler.hpp"
+
+// Frame sequences for zoom videos, written as numbered PNG files.
+//
+// The path is a list of keyframes (frame, center, pixel size). Between two
+// keyframes the pixel size changes exponentially, so the zoom speed looks
+// constant, and the center moves as if the view zoomed about one fixed
+// point, so nothing slides across the screen.
+//
+// Frames go through three stages on their own threads: compute (the tile
+// scheduler's workers), colorize, and PNG encode on several encoder
+// threads. Frame N+1 computes while frame N is colorized and encoded; a
+// small pool of frame buffers bounds how far compute can run ahead.
+//
+// With a reprojection scale S > 1 a key frame is rendered S times larger
+// in each direction, and the following frames are resampled from it
+// (nearest sample) while it is still at least as dense as they are; only
+// the pixels it does not cover are computed. Zooming in by a factor of S
+// then costs one S*S-sized render instead of log(S)/log(1/zoom) frames.
+// Resampled frames are approximate: a sample is up to half a frame pixel
+// from its pixel's center.
+
+// Frame buffers in flight between the stages, beyond one per encoder
+const int ZOOM_PIPELINE_SPARE_FRAMES = 2;
+
+// Share of a reprojected frame that may be left to compute before the key
+// is rendered again
+const double REPROJECT_MAX_UNCOVERED = 0.25;
+
+// Centers are double-double, so a path can zoom past the resolution of a
+// double (about 1e-16 of the center) without the frames drifting off it
+struct ZoomKeyframe {
+    int frame;
+    DoubleDouble centerReal;
+    DoubleDouble centerImag;
+    double pixelSize;
+};
+
+struct ZoomSettings {
+    int width;
+    int height;
+    int maxIterations;
+    int reprojectScale; // 0 or 1: render every frame in full
+    int encoders;       // 0: a quarter of the hardware threads
+    std::string prefix; // frame n is written to <prefix><n, 5 digits>.png
+
+    ZoomSettings()
+        : width(1280), height(720), maxIterations(1000), reprojectScale(0), encoders(0), prefix("frame_") {}
+};
+
+struct ZoomStats {
+    int frames;
+    int keyRenders;
+    long long pixelsComputed;
+    long long pixelsShown;
+    double seconds;
+    double computeSeconds; // busy time of each stage; they overlap
+    double colorizeSeconds;
+    double encodeSeconds;
+    bool writeFailed;
+
+    ZoomStats()
+        : frames(0), keyRenders(0), pixelsComputed(0), pixelsShown(0), seconds(0.0), computeSeconds(0.0),
+          colorizeSeconds(0.0), encodeSeconds(0.0), writeFailed(false) {}
+};
+
+// Function to read keyframes, one "frame center_real center_imag
+// pixel_size" per line ('#' starts a comment). Centers are read to
+// double-double precision, so give them as many digits as the zoom depth
+// needs. Returns false if the file is missing or has no keyframe.
+inline bool loadZoomPath(const char* path, std::vector<ZoomKeyframe>& keyframes) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    keyframes.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        ZoomKeyframe key;
+        std::string real, imag;
+        if (fields >> key.frame >> real >> imag >> key.pixelSize && key.frame >= 0 && key.pixelSize > 0.0 &&
+            parseDoubleDouble(real.c_str(), key.centerReal) && parseDoubleDouble(imag.c_str(), key.centerImag)) {
+            keyframes.push_back(key);
+        }
+    }
+    std::sort(keyframes.begin(), keyframes.end(),
+              [](const ZoomKeyframe& a, const ZoomKeyframe& b) { return a.frame < b.frame; });
+    return !keyframes.empty();
+}
+
+// Function to get the view of a frame of the path
+inline Viewport zoomPathView(const std::vector<ZoomKeyframe>& keyframes, int frame, int width, int height) {
+    size_t next = 0;
+    while (next < keyframes.size() && keyframes[next].frame <= frame) {
+        next++;
+    }
+    const ZoomKeyframe& a = keyframes[next == 0 ? 0 : next - 1];
+    const ZoomKeyframe& b = keyframes[std::min(next, keyframes.size() - 1)];
+
+    Viewport view(width, height);
+    double t = b.frame > a.frame ? static_cast<double>(frame - a.frame) / (b.frame - a.frame) : 0.0;
+    t = std::min(1.0, std::max(0.0, t));
+    view.pixelSize = a.pixelSize * std::pow(b.pixelSize / a.pixelSize, t);
+    // Zooming about a fixed point moves the center in proportion to the
+    // change of scale; without a change of scale, pan linearly
+    double w = std::fabs(a.pixelSize - b.pixelSize) > 1e-9 * a.pixelSize
+                   ? (a.pixelSize - view.pixelSize) / (a.pixelSize - b.pixelSize) : t;
+    DoubleDouble real = a.centerReal + (b.centerReal - a.centerReal) * DoubleDouble(w);
+    DoubleDouble imag = a.centerImag + (b.centerImag - a.centerImag) * DoubleDouble(w);
+    view.centerReal = real.hi;
+    view.centerRealLo = real.lo;
+    view.centerImag = imag.hi;
+    view.centerImagLo = imag.lo;
+    return view;
+}
+
+// Queue between two pipeline stages; pop() returns false once the queue
+// is closed and empty
+template <typename T>
+class StageQueue {
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<T> items;
+    bool closed;
+
+public:
+    StageQueue() : closed(false) {}
+
+    void push(const T& item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(item);
+        }
+        ready.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        ready.notify_all();
+    }
+};
+
+class ZoomSequence {
+private:
+    struct Frame {
+        int index;
+        std::vector<int> iterations;
+        std::vector<uint32_t> pixels;
+    };
+
+    ZoomSettings settings;
+    FractalParams params;
+    TileScheduler scheduler;
+    std::mutex wakeMutex;
+    std::condition_variable wakeReady;
+    bool woken;
+
+    // Reprojection key: a larger render the next frames are sampled from
+    Viewport keyView;
+    std::vector<int> key;
+
+    // Function to render a whole view on the scheduler's workers
+    void renderView(const Viewport& view, std::vector<int>& out) {
+        int generation = scheduler.submit(view, params, settings.maxIterations, choosePrecision(view, params));
+        for (int remaining = scheduler.tileCount(generation); remaining > 0;) {
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeReady.wait(lock, [this] { return woken; });
+                woken = false;
+            }
+            while (remaining > 0 && scheduler.popCompleted() != nullptr) {
+                remaining--;
+            }
+        }
+        const int* iterations = scheduler.iterations(generation);
+        out.assign(iterations, iterations + static_cast<size_t>(view.width) * view.height);
+    }
+
+    // Function to sample a frame from the key; uncovered pixels are set to
+    // -1 and counted
+    long long reproject(const Viewport& view, int* out) const {
+        long long uncovered = 0;
+        for (int y = 0; y < view.height; ++y) {
+            double x0, y0, x1, y1;
+            view.mapTo(keyView, 0.0, y, x0, y0);
+            view.mapTo(keyView, 1.0, y, x1, y1);
+            int ky = static_cast<int>(std::floor(y0 + 0.5));
+            int* row = out + static_cast<size_t>(y) * view.width;
+            for (int x = 0; x < view.width; ++x) {
+                int kx = static_cast<int>(std::floor(x0 + (x1 - x0) * x + 0.5));
+                if (kx >= 0 && ky >= 0 && kx < keyView.width && ky < keyView.height) {
+                    row[x] = key[static_cast<size_t>(ky) * keyView.width + kx];
+                } else {
+                    row[x] = -1;
+                    uncovered++;
+                }
+            }
+        }
+        return uncovered;
+    }
+
+    // Function to compute the pixels reproject() left uncovered, rows
+    // shared out between threads
+    void fillUncovered(const Viewport& view, int* out) const {
+        FrameKernel kernel;
+        kernel.prepare(view, params, settings.maxIterations, choosePrecision(view, params));
+        std::atomic<int> nextRow(0);
+        auto work = [&] {
+            for (int y = nextRow++; y < view.height; y = nextRow++) {
+                int* row = out + static_cast<size_t>(y) * view.width;
+                for (int x = 0; x < view.width;) {
+                    if (row[x] >= 0) {
+                        x++;
+                        continue;
+                    }
+                    int end = x;
+                    while (end < view.width && row[end] < 0) {
+                        end++;
+                    }
+                    kernel.renderRect(x, y, end, y + 1, &row[x], view.width, nullptr);
+                    x = end;
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < scheduler.threadCount(); ++t) {
+            threads.push_back(std::thread(work));
+        }
+        work();
+        for (size_t t = 0; t < threads.size(); ++t) {
+            threads[t].join();
+        }
+    }
+
+    // Function to compute one frame's iterations; returns the pixels computed
+    long long computeFrame(const Viewport& view, std::vector<int>& out, ZoomStats& stats) {
+        int scale = settings.reprojectScale;
+        if (scale <= 1) {
+            renderView(view, out);
+            return static_cast<long long>(view.width) * view.height;
+        }
+
+        out.resize(static_cast<size_t>(view.width) * view.height);
+        long long limit = static_cast<long long>(REPROJECT_MAX_UNCOVERED * view.width * view.height);
+        long long uncovered = 0;
+        bool rekey = key.empty() || view.pixelSize < keyView.pixelSize;
+        if (!rekey) {
+            uncovered = reproject(view, out.data());
+            rekey = uncovered > limit;
+        }
+        if (!rekey) {
+            if (uncovered > 0) {
+                fillUncovered(view, out.data());
+            }
+            return uncovered;
+        }
+
+        keyView = view;
+        keyView.width = view.width * scale;
+        keyView.height = view.height * scale;
+        keyView.pixelSize = view.pixelSize / scale;
+        renderView(keyView, key);
+        stats.keyRenders++;
+        reproject(view, out.data());
+        return static_cast<long long>(keyView.width) * keyView.height;
+    }
+
+public:
+    ZoomSequence(const ZoomSettings& zoomSettings) : settings(zoomSettings), woken(false), keyView(1, 1) {
+        scheduler.setWakeCallback([this] {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            woken = true;
+            wakeReady.notify_one();
+        });
+    }
+
+    // Function to render and write every frame of the path
+    ZoomStats run(const std::vector<ZoomKeyframe>& keyframes) {
+        ZoomStats stats;
+        auto start = std::chrono::steady_clock::now();
+        int frames = keyframes.back().frame + 1;
+        int encoders = settings.encoders > 0
+                           ? settings.encoders
+                           : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) / 4);
+        scheduler.start(0);
+
+        std::vector<Frame> buffers(encoders + ZOOM_PIPELINE_SPARE_FRAMES);
+        StageQueue<Frame*> spare;
+        StageQueue<Frame*> toColorize;
+        StageQueue<Frame*> toEncode;
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            buffers[i].pixels.resize(static_cast<size_t>(settings.width) * settings.height);
+            spare.push(&buffers[i]);
+        }
+        std::mutex statsMutex;
+
+        std::thread colorizer([&] {
+            Frame* frame;
+            while (toColorize.pop(frame)) {
+                auto begin = std::chrono::steady_clock::now();
+                mandel_colorize(frame->iterations.data(), static_cast<int>(frame->pixels.size()),
+                                settings.maxIterations, MANDEL_PALETTE_BANDS, frame->pixels.data());
+                stats.colorizeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                toEncode.push(frame);
+            }
+            toEncode.close();
+        });
+
+        std::vector<std::thread> encoderThreads;
+        for (int e = 0; e < encoders; ++e) {
+            encoderThreads.push_back(std::thread([&] {
+                Frame* frame;
+                while (toEncode.pop(frame)) {
+                    auto begin = std::chrono::steady_clock::now();
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "%05d.png", frame->index);
+                    bool saved = savePng((settings.prefix + name).c_str(), frame->pixels.data(), settings.width,
+                                         settings.height, settings.width);
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+                    {
+                        std::lock_guard<std::mutex> lock(statsMutex);
+                        stats.encodeSeconds += seconds;
+                        stats.writeFailed = stats.writeFailed || !saved;
+                    }
+                    spare.push(frame);
+                }
+            }));
+        }
+
+        // Compute stage, on this thread and the scheduler's workers
+        for (int index = 0; index < frames; ++index) {
+            Frame* frame;
+            spare.pop(frame);
+            auto begin = std::chrono::steady_clock::now();
+            Viewport view = zoomPathView(keyframes, index, settings.width, settings.height);
+            stats.pixelsComputed += computeFrame(view, frame->iterations, stats);
+            stats.pixelsShown += static_cast<long long>(view.width) * view.height;
+            stats.computeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            frame->index = index;
+            toColorize.push(frame);
+            stats.frames++;
+        }
+        toColorize.close();
+        colorizer.join();
+        for (size_t e = 0; e < encoderThreads.size(); ++e) {
+            encoderThreads[e].join();
+        }
+        scheduler.stop();
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return stats;
+    }
+};
+
+#endif
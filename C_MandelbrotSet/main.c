@@ -1,58 +1,144 @@
 #include <SDL2/SDL.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Build with -DUSE_LIBMANDEL to render through the shared C++ core in
+// ../libmandel; by default the viewer uses its own threaded SSE2 renderer
+// and needs nothing but SDL2.
+#ifdef USE_LIBMANDEL
+#include "mandel.h"
+#else
+#include "render.h"
+#endif
 
 // Window size
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
-// Function to check if a point is in the Mandelbrot set
-int mandelbrot(double real, double imag, int max_iter) {
-    double z_real = real;
-    double z_imag = imag;
-    int n;
+// Headless benchmark (--bench): the same zoom into Seahorse Valley as the
+// C++ viewer's, rendered BENCH_PASSES times; the fastest pass is reported
+const int BENCH_FRAMES = 24;
+const int BENCH_PASSES = 3;
+const int BENCH_ITERATIONS = 1000;
+const double BENCH_ZOOM = 0.8;
+const double BENCH_CENTER_REAL = -0.743643;
+const double BENCH_CENTER_IMAG = 0.131825;
 
-    for (n = 0; n < max_iter; ++n) {
-        if (z_real * z_real + z_imag * z_imag > 4.0)
-            break;
+#ifdef USE_LIBMANDEL
+// Function to render the Mandelbrot set through libmandel and copy it into
+// the streaming texture. Returns 0 on success.
+int draw_mandelbrot(mandel_context *context, SDL_Texture *texture, int max_iter) {
+    mandel_request request;
+    mandel_request_init(&request, WIDTH, HEIGHT);
+    request.max_iterations = max_iter;
 
-        double new_real = z_real * z_real - z_imag * z_imag + real;
-        double new_imag = 2.0 * z_real * z_imag + imag;
+    int *iterations = malloc(sizeof(int) * WIDTH * HEIGHT);
+    uint32_t *pixels = malloc(sizeof(uint32_t) * WIDTH * HEIGHT);
+    if (iterations == NULL || pixels == NULL) {
+        printf("Out of memory\n");
+        free(iterations);
+        free(pixels);
+        return 1;
+    }
 
-        z_real = new_real;
-        z_imag = new_imag;
+    if (mandel_render(context, &request, iterations) != 0) {
+        printf("Unable to render: %s\n", mandel_error(context));
+        free(iterations);
+        free(pixels);
+        return 1;
     }
 
-    return n;
+    // Grayscale, brighter the longer a point takes to escape
+    mandel_colorize(iterations, WIDTH * HEIGHT, max_iter, MANDEL_PALETTE_GRAYSCALE, pixels);
+    SDL_UpdateTexture(texture, NULL, pixels, WIDTH * sizeof(uint32_t));
+
+    free(iterations);
+    free(pixels);
+    return 0;
 }
+#endif
+
+// Function to run the benchmark zoom without a window. Returns 0 on success.
+// Usage: --bench [frames]
+int run_bench(int frames) {
+    Uint32 *pixels = malloc(sizeof(Uint32) * WIDTH * HEIGHT);
+#ifdef USE_LIBMANDEL
+    int *iterations = malloc(sizeof(int) * WIDTH * HEIGHT);
+    mandel_context *context = mandel_create(0);
+    if (pixels == NULL || iterations == NULL || context == NULL) {
+        printf("Unable to set up rendering\n");
+        mandel_destroy(context);
+        free(iterations);
+        free(pixels);
+        return 1;
+    }
+    int threads = mandel_thread_count(context);
+    mandel_request request;
+    mandel_request_init(&request, WIDTH, HEIGHT);
+    request.max_iterations = BENCH_ITERATIONS;
+    request.center_real = BENCH_CENTER_REAL;
+    request.center_imag = BENCH_CENTER_IMAG;
+#else
+    if (pixels == NULL) {
+        printf("Unable to set up rendering\n");
+        return 1;
+    }
+    int threads = 0;
+    render_job job;
+    render_init(&job, WIDTH, HEIGHT, BENCH_ITERATIONS, pixels);
+    job.center_real = BENCH_CENTER_REAL;
+    job.center_imag = BENCH_CENTER_IMAG;
+#endif
 
-// Function to draw the Mandelbrot set to the screen using SDL
-void draw_mandelbrot(SDL_Renderer *renderer, int max_iter) {
-    // Range of complex coordinates
-    const double xmin = -2.0;
-    const double xmax = 1.0;
-    const double ymin = -1.5;
-    const double ymax = 1.5;
-
-    // Iterate through each pixel on the screen
-    for (int y = 0; y < HEIGHT; ++y) {
-        for (int x = 0; x < WIDTH; ++x) {
-            // Calculate the complex coordinates for this pixel
-            double real = xmin + (xmax - xmin) * x / WIDTH;
-            double imag = ymin + (ymax - ymin) * y / HEIGHT;
-
-            // Calculate Mandelbrot iterations
-            int val = mandelbrot(real, imag, max_iter);
-
-            // Determine color based on the number of iterations
-            int color = (val * 255) / max_iter;
-            SDL_SetRenderDrawColor(renderer, color, color, color, 255);
-            SDL_RenderDrawPoint(renderer, x, y);
+    double best = 0.0;
+    for (int pass = 0; pass < BENCH_PASSES; ++pass) {
+        double pixel_size = 3.0 / HEIGHT;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int frame = 0; frame < frames; ++frame) {
+#ifdef USE_LIBMANDEL
+            request.pixel_size = pixel_size;
+            if (mandel_render(context, &request, iterations) != 0) {
+                printf("Unable to render: %s\n", mandel_error(context));
+                mandel_destroy(context);
+                free(iterations);
+                free(pixels);
+                return 1;
+            }
+            mandel_colorize(iterations, WIDTH * HEIGHT, BENCH_ITERATIONS, MANDEL_PALETTE_GRAYSCALE, pixels);
+#else
+            job.pixel_size = pixel_size;
+            if (render_start(&job) != 0) {
+                free(pixels);
+                return 1;
+            }
+            threads = job.thread_count;
+            render_wait(&job, 0);
+#endif
+            pixel_size *= BENCH_ZOOM;
+        }
+        double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        if (pass == 0 || ms < best) {
+            best = ms;
         }
     }
+    printf("Bench: %d frames on %d threads, best of %d passes: %.2f ms per frame\n", frames, threads,
+           BENCH_PASSES, best / frames);
+
+#ifdef USE_LIBMANDEL
+    mandel_destroy(context);
+    free(iterations);
+#endif
+    free(pixels);
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return run_bench(argc > 2 ? atoi(argv[2]) : BENCH_FRAMES);
+    }
+
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("Unable to initialize SDL: %s\n", SDL_GetError());
@@ -77,24 +163,110 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // Create the texture the rendered pixels are copied into
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT);
+    if (texture == NULL) {
+        printf("Unable to create texture: %s\n", SDL_GetError());
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+#ifdef USE_LIBMANDEL
+    // Worker threads of the shared fractal core, one per hardware thread
+    mandel_context *context = mandel_create(0);
+    if (context == NULL) {
+        printf("Unable to start the fractal core\n");
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
     // Draw Mandelbrot set
-    draw_mandelbrot(renderer, 1000);
+    Uint32 start = SDL_GetTicks();
+    if (draw_mandelbrot(context, texture, 1000) == 0) {
+        printf("Rendered in %u ms on %d threads (%s)\n", (unsigned)(SDL_GetTicks() - start),
+               mandel_thread_count(context), mandel_precision_name(mandel_last_precision(context)));
+    }
 
     // Display the result
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
     SDL_RenderPresent(renderer);
+#else
+    // Pixel buffer the workers write into, uploaded once they are done
+    Uint32 *pixels = malloc(sizeof(Uint32) * WIDTH * HEIGHT);
+    Uint32 done_event = SDL_RegisterEvents(1);
+    if (pixels == NULL || done_event == (Uint32)-1) {
+        printf("Unable to set up rendering\n");
+        free(pixels);
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+
+    // Show black until the render is done
+    SDL_memset4(pixels, 0xFF000000u, WIDTH * HEIGHT);
+    SDL_UpdateTexture(texture, NULL, pixels, WIDTH * sizeof(Uint32));
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+
+    // Draw Mandelbrot set on worker threads; the window stays responsive
+    // and the result is shown when done_event arrives
+    render_job job;
+    render_init(&job, WIDTH, HEIGHT, 1000, pixels);
+    job.done_event = done_event;
+    Uint32 start = SDL_GetTicks();
+    if (render_start(&job) != 0) {
+        free(pixels);
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+#endif
 
-    // Wait until the user closes the window
+    // Wait until the user closes the window. The loop sleeps in
+    // SDL_WaitEventTimeout (a negative timeout waits for the next event)
+    // instead of polling, so a static image uses no CPU.
     SDL_Event e;
     int quit = 0;
-    while (!quit) {
-        while (SDL_PollEvent(&e) != 0) {
+    while (!quit && SDL_WaitEventTimeout(&e, -1)) {
+        do {
             if (e.type == SDL_QUIT) {
                 quit = 1;
+#ifndef USE_LIBMANDEL
+            } else if (e.type == done_event) {
+                int threads = job.thread_count;
+                render_wait(&job, 0);
+                printf("Rendered in %u ms on %d threads\n", (unsigned)(SDL_GetTicks() - start), threads);
+
+                // Display the result
+                SDL_UpdateTexture(texture, NULL, pixels, WIDTH * sizeof(Uint32));
+                SDL_RenderCopy(renderer, texture, NULL, NULL);
+                SDL_RenderPresent(renderer);
+#endif
+            } else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                // Show the texture again; nothing is re-rendered
+                SDL_RenderCopy(renderer, texture, NULL, NULL);
+                SDL_RenderPresent(renderer);
             }
-        }
+        } while (SDL_PollEvent(&e) != 0);
     }
 
     // Clean up and exit
+#ifdef USE_LIBMANDEL
+    mandel_destroy(context);
+#else
+    render_wait(&job, 1);
+    free(pixels);
+#endif
+    SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -0,0 +1,166 @@
+#include "render.h"
+
+#include <stdio.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Function to check if a point is in the Mandelbrot set. Returns the
+// number of iterations before |z| > 2, or max_iter.
+static int mandelbrot(double real, double imag, int max_iter) {
+    double z_real = real;
+    double z_imag = imag;
+    int n;
+
+    for (n = 0; n < max_iter; ++n) {
+        if (z_real * z_real + z_imag * z_imag > 4.0)
+            break;
+
+        double new_real = z_real * z_real - z_imag * z_imag + real;
+        double new_imag = 2.0 * z_real * z_imag + imag;
+
+        z_real = new_real;
+        z_imag = new_imag;
+    }
+
+    return n;
+}
+
+#ifdef __SSE2__
+// Function to iterate four points of one row at once: two SSE2 registers of
+// two doubles each, so one register's multiplies overlap the other's.
+// Escaped lanes drop out of the active mask and stop counting; the loop
+// ends when no lane is active. Counts match mandelbrot() exactly.
+static void mandelbrot_sse2(const double *real, double imag, int max_iter, int *out) {
+    const __m128d four = _mm_set1_pd(4.0);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d ci = _mm_set1_pd(imag);
+    const __m128d cr0 = _mm_loadu_pd(real);
+    const __m128d cr1 = _mm_loadu_pd(real + 2);
+
+    __m128d zr0 = cr0, zi0 = ci, zr1 = cr1, zi1 = ci;
+    __m128d active0 = _mm_cmpeq_pd(one, one);
+    __m128d active1 = active0;
+    __m128d count0 = _mm_setzero_pd();
+    __m128d count1 = _mm_setzero_pd();
+
+    for (int n = 0; n < max_iter; ++n) {
+        __m128d rr0 = _mm_mul_pd(zr0, zr0), ii0 = _mm_mul_pd(zi0, zi0);
+        __m128d rr1 = _mm_mul_pd(zr1, zr1), ii1 = _mm_mul_pd(zi1, zi1);
+
+        active0 = _mm_and_pd(active0, _mm_cmple_pd(_mm_add_pd(rr0, ii0), four));
+        active1 = _mm_and_pd(active1, _mm_cmple_pd(_mm_add_pd(rr1, ii1), four));
+        if ((_mm_movemask_pd(active0) | _mm_movemask_pd(active1)) == 0)
+            break;
+        count0 = _mm_add_pd(count0, _mm_and_pd(active0, one));
+        count1 = _mm_add_pd(count1, _mm_and_pd(active1, one));
+
+        __m128d ri0 = _mm_mul_pd(zr0, zi0), ri1 = _mm_mul_pd(zr1, zi1);
+        zi0 = _mm_add_pd(_mm_add_pd(ri0, ri0), ci);
+        zi1 = _mm_add_pd(_mm_add_pd(ri1, ri1), ci);
+        zr0 = _mm_add_pd(_mm_sub_pd(rr0, ii0), cr0);
+        zr1 = _mm_add_pd(_mm_sub_pd(rr1, ii1), cr1);
+    }
+
+    double counts[4];
+    _mm_storeu_pd(counts, count0);
+    _mm_storeu_pd(counts + 2, count1);
+    for (int i = 0; i < 4; ++i)
+        out[i] = (int)counts[i];
+}
+#endif
+
+// Function to render one row into the pixel buffer, in grayscale: brighter
+// the longer a point takes to escape
+static void render_row(const render_job *job, int y) {
+    const double imag = job->center_imag + (y - job->height * 0.5) * job->pixel_size;
+    Uint32 *row = job->pixels + (size_t)y * job->width;
+    int x = 0;
+
+#ifdef __SSE2__
+    for (; x + 4 <= job->width; x += 4) {
+        double real[4];
+        int n[4];
+        for (int i = 0; i < 4; ++i)
+            real[i] = job->center_real + (x + i - job->width * 0.5) * job->pixel_size;
+        mandelbrot_sse2(real, imag, job->max_iter, n);
+        for (int i = 0; i < 4; ++i) {
+            Uint32 level = (Uint32)((long long)n[i] * 255 / job->max_iter);
+            row[x + i] = 0xFF000000u | (level << 16) | (level << 8) | level;
+        }
+    }
+#endif
+    for (; x < job->width; ++x) {
+        double real = job->center_real + (x - job->width * 0.5) * job->pixel_size;
+        int n = mandelbrot(real, imag, job->max_iter);
+        Uint32 level = (Uint32)((long long)n * 255 / job->max_iter);
+        row[x] = 0xFF000000u | (level << 16) | (level << 8) | level;
+    }
+}
+
+// Function run by each worker: claim rows until none are left. Rows vary a
+// lot in cost, so claiming them one at a time keeps the workers balanced.
+static int render_worker(void *data) {
+    render_job *job = (render_job *)data;
+    int y;
+
+    while (!SDL_AtomicGet(&job->cancel) && (y = SDL_AtomicAdd(&job->next_row, 1)) < job->height) {
+        render_row(job, y);
+
+        // SDL_AtomicAdd returns the old value: 1 means this was the last row
+        if (SDL_AtomicAdd(&job->rows_left, -1) == 1 && job->done_event != 0) {
+            SDL_Event event;
+            SDL_zero(event);
+            event.type = job->done_event;
+            event.user.data1 = job;
+            SDL_PushEvent(&event);
+        }
+    }
+    return 0;
+}
+
+void render_init(render_job *job, int width, int height, int max_iter, Uint32 *pixels) {
+    SDL_zerop(job);
+    job->center_real = -0.5;
+    job->center_imag = 0.0;
+    job->pixel_size = 3.0 / height;
+    job->width = width;
+    job->height = height;
+    job->max_iter = max_iter;
+    job->pixels = pixels;
+}
+
+int render_start(render_job *job) {
+    SDL_AtomicSet(&job->next_row, 0);
+    SDL_AtomicSet(&job->rows_left, job->height);
+    SDL_AtomicSet(&job->cancel, 0);
+
+    int threads = SDL_GetCPUCount();
+    if (threads < 1)
+        threads = 1;
+    if (threads > RENDER_MAX_THREADS)
+        threads = RENDER_MAX_THREADS;
+
+    job->thread_count = 0;
+    for (int i = 0; i < threads; ++i) {
+        SDL_Thread *thread = SDL_CreateThread(render_worker, "render", job);
+        if (thread == NULL) {
+            // The threads already running still finish every row
+            if (job->thread_count > 0)
+                break;
+            printf("Unable to create render thread: %s\n", SDL_GetError());
+            return 1;
+        }
+        job->threads[job->thread_count++] = thread;
+    }
+    return 0;
+}
+
+void render_wait(render_job *job, int cancel) {
+    if (cancel)
+        SDL_AtomicSet(&job->cancel, 1);
+    for (int i = 0; i < job->thread_count; ++i)
+        SDL_WaitThread(job->threads[i], NULL);
+    job->thread_count = 0;
+}
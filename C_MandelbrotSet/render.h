@@ -0,0 +1,42 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL2/SDL.h>
+
+// Most worker threads a render uses
+#define RENDER_MAX_THREADS 64
+
+// A render of the Mandelbrot set into an ARGB8888 pixel buffer, split into
+// rows that worker threads claim from a shared counter. render_start()
+// returns at once; the last worker to finish pushes done_event.
+typedef struct render_job {
+    // What to render: square pixels around a center
+    double center_real;
+    double center_imag;
+    double pixel_size;
+    int width;
+    int height;
+    int max_iter;
+
+    Uint32 *pixels;    // width * height, row-major
+    Uint32 done_event; // SDL user event type, or 0 for none
+
+    // Shared by the workers
+    SDL_atomic_t next_row;
+    SDL_atomic_t rows_left;
+    SDL_atomic_t cancel;
+    int thread_count;
+    SDL_Thread *threads[RENDER_MAX_THREADS];
+} render_job;
+
+// Function to fill in a job for the full set; pixels must hold width * height
+void render_init(render_job *job, int width, int height, int max_iter, Uint32 *pixels);
+
+// Function to start the workers. Returns 0 on success.
+int render_start(render_job *job);
+
+// Function to wait for the workers; with cancel set they stop after their
+// current row
+void render_wait(render_job *job, int cancel);
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef AUTOTUNE_HPP
+#define AUTOTUNE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#include "fractal.hpp"
+#include "mandel.h"
+#include "precision.hpp"
+#include "tile_scheduler.hpp"
+
+// Kernel auto-tuner. The fastest worker count, lane layout and whether the
+// float rung pays off all differ between CPUs, so they are measured on this
+// machine in a few hundred milliseconds and saved to a small key=value
+// file. Later runs load the file instead, until the CPU model or
+// MANDEL_VERSION no longer matches it.
+//
+// Not tuned:
+// - The tile size: it is also the lattice of the tile cache.
+// - The SIMD width: LaneWidth<T> is a template parameter of every kernel,
+//   so only the widths compiled in could be picked between, and the build
+//   already compiles for one instruction set. The lane layout (refill or
+//   lockstep) is the runtime choice that remains.
+// - The precision crossovers: FLOAT_MIN_SPACING and DOUBLE_MIN_SPACING are
+//   where float and double stop resolving pixels, not speed trade-offs, so
+//   moving them would change the image; the only speed choice below them,
+//   float or double, is tuned. Past double, perturbation measured about 7x
+//   faster than double-double at every depth, so there is no crossover to
+//   find there either.
+
+// Time the whole tune may take, split evenly between the candidates
+const double TUNE_BUDGET_SECONDS = 0.3;
+
+// Smallest speed-up a candidate needs to replace the default
+const double TUNE_MIN_GAIN = 0.05;
+
+// Test frames: a view mixing interior, boundary and exterior, small for the
+// single-thread kernel tests and with enough tiles for the thread test
+const int TUNE_KERNEL_WIDTH = 192;
+const int TUNE_KERNEL_HEIGHT = 128;
+const int TUNE_POOL_WIDTH = 512;
+const int TUNE_POOL_HEIGHT = 384;
+const int TUNE_ITERATIONS = 256;
+
+struct TuneConfig {
+    std::string version;
+    std::string cpu;
+    int threads;
+    LaneLayout layout;
+    bool useFloat; // false: views float would resolve render in double
+
+    // What the tune measured, kept in the file for reference
+    double refillNs;   // per pixel, single thread, double
+    double lockstepNs;
+    double floatNs;    // per pixel, single thread, float, chosen layout
+    double frameMs;    // whole test frame on the chosen thread count
+    double tuneMs;
+
+    TuneConfig()
+        : threads(0), layout(LaneLayout::Refill), useFloat(true),
+          refillNs(0.0), lockstepNs(0.0), floatNs(0.0), frameMs(0.0), tuneMs(0.0) {}
+};
+
+// Function to describe this machine: the CPU brand string and its number
+// of hardware threads
+inline std::string cpuModel() {
+    std::string brand;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int regs[12];
+    if (__get_cpuid(0x80000004, &regs[0], &regs[1], &regs[2], &regs[3])) {
+        for (unsigned int leaf = 0; leaf < 3; ++leaf) {
+            __get_cpuid(0x80000002 + leaf, &regs[leaf * 4], &regs[leaf * 4 + 1], &regs[leaf * 4 + 2],
+                        &regs[leaf * 4 + 3]);
+        }
+        brand = std::string(reinterpret_cast<const char*>(regs), 48).c_str();
+    }
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[12];
+    for (int leaf = 0; leaf < 3; ++leaf) {
+        __cpuid(&regs[leaf * 4], 0x80000002 + leaf);
+    }
+    brand = std::string(reinterpret_cast<const char*>(regs), 48).c_str();
+#else
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 10, "model name") == 0 || line.compare(0, 9, "Processor") == 0) {
+            brand = line.substr(line.find(':') + 1);
+            break;
+        }
+    }
+#endif
+    // Trim the padding some CPUs put around the brand string
+    size_t first = brand.find_first_not_of(' ');
+    size_t last = brand.find_last_not_of(' ');
+    brand = first == std::string::npos ? "unknown" : brand.substr(first, last - first + 1);
+    std::ostringstream model;
+    model << brand << " x" << std::max(1u, std::thread::hardware_concurrency());
+    return model.str();
+}
+
+// Function to tell whether a saved configuration was measured by this
+// library version on this CPU
+inline bool matchesHost(const TuneConfig& config) {
+    return config.version == MANDEL_VERSION && config.cpu == cpuModel();
+}
+
+// Function to read a saved configuration; false if the file is missing or
+// incomplete
+inline bool loadTuneConfig(const char* path, TuneConfig& config) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    TuneConfig loaded;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, equals);
+        std::string value = line.substr(equals + 1);
+        if (key == "version") {
+            loaded.version = value;
+        } else if (key == "cpu") {
+            loaded.cpu = value;
+        } else if (key == "threads") {
+            loaded.threads = std::atoi(value.c_str());
+        } else if (key == "lane_layout") {
+            loaded.layout = value == "lockstep" ? LaneLayout::Lockstep : LaneLayout::Refill;
+        } else if (key == "float") {
+            loaded.useFloat = value == "1";
+        }
+    }
+    if (loaded.version.empty() || loaded.cpu.empty() || loaded.threads <= 0) {
+        return false;
+    }
+    config = loaded;
+    return true;
+}
+
+inline bool saveTuneConfig(const char* path, const TuneConfig& config) {
+    std::ofstream file(path);
+    file << "# Kernel tuning for this machine, written by the auto-tuner.\n"
+         << "# Delete the file (or run with --tune) to measure again.\n"
+         << "version=" << config.version << "\n"
+         << "cpu=" << config.cpu << "\n"
+         << "threads=" << config.threads << "\n"
+         << "lane_layout=" << (config.layout == LaneLayout::Lockstep ? "lockstep" : "refill") << "\n"
+         << "float=" << (config.useFloat ? 1 : 0) << "\n"
+         << "# measured: refill " << config.refillNs << " ns/px, lockstep " << config.lockstepNs
+         << " ns/px, float " << config.floatNs << " ns/px, frame " << config.frameMs << " ms on "
+         << config.threads << " threads, tune took " << config.tuneMs << " ms\n";
+    file.close();
+    return !file.fail();
+}
+
+namespace detail {
+
+// Function to render a frame with one kernel over and over for the given
+// time, and return the fastest run in seconds
+inline double timeKernel(const Viewport& view, Precision precision, LaneLayout layout, double seconds) {
+    FrameKernel kernel;
+    kernel.prepare(view, FractalParams(), TUNE_ITERATIONS, precision, layout);
+    std::vector<int> out(static_cast<size_t>(view.width) * view.height);
+    double best = 1e30;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    do {
+        auto start = std::chrono::steady_clock::now();
+        kernel.renderRect(0, 0, view.width, view.height, out.data(), view.width, nullptr);
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    } while (std::chrono::steady_clock::now() < deadline);
+    return best;
+}
+
+// Function to render frames on a pool of the given size for the given
+// time, and return the fastest frame in seconds
+inline double timePool(const Viewport& view, int threads, LaneLayout layout, Precision precision,
+                       double seconds) {
+    TileScheduler scheduler;
+    scheduler.setOrder(TileOrder::Fifo);
+    scheduler.setLaneLayout(layout);
+    scheduler.start(threads);
+    double best = 1e30;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    do {
+        auto start = std::chrono::steady_clock::now();
+        int generation = scheduler.submit(view, FractalParams(), TUNE_ITERATIONS, precision);
+        for (int done = 0; done < scheduler.tileCount(generation);) {
+            if (scheduler.popCompleted() != nullptr) {
+                done++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    } while (std::chrono::steady_clock::now() < deadline);
+    scheduler.stop();
+    return best;
+}
+
+inline Viewport tuneView(int width, int height) {
+    Viewport view(width, height);
+    view.centerReal = -0.75;
+    view.centerImag = 0.1;
+    view.pixelSize = 2.5 / width;
+    return view;
+}
+
+} // namespace detail
+
+// Function to measure the candidates on this machine and pick the fastest.
+// A candidate has to beat the default by TUNE_MIN_GAIN to be chosen, so
+// noise does not flip the result between runs.
+inline TuneConfig autoTune() {
+    auto start = std::chrono::steady_clock::now();
+    TuneConfig config;
+    config.version = MANDEL_VERSION;
+    config.cpu = cpuModel();
+
+    // Worker counts: every hardware thread, one per core on SMT machines,
+    // and one left over for the UI thread
+    int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    counts.push_back(hardware);
+    if (hardware / 2 >= 1) {
+        counts.push_back(hardware / 2);
+    }
+    if (hardware - 1 >= 1) {
+        counts.push_back(hardware - 1);
+    }
+    std::sort(counts.begin(), counts.end());
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+    double slice = TUNE_BUDGET_SECONDS / (3 + counts.size());
+
+    // Lane layout and float against double, one thread
+    Viewport small = detail::tuneView(TUNE_KERNEL_WIDTH, TUNE_KERNEL_HEIGHT);
+    double pixels = static_cast<double>(small.width) * small.height;
+    double refill = detail::timeKernel(small, Precision::Double, LaneLayout::Refill, slice);
+    double lockstep = detail::timeKernel(small, Precision::Double, LaneLayout::Lockstep, slice);
+    config.layout = lockstep < refill * (1.0 - TUNE_MIN_GAIN) ? LaneLayout::Lockstep : LaneLayout::Refill;
+    double chosen = std::min(refill, lockstep);
+    double single = detail::timeKernel(small, Precision::Float, config.layout, slice);
+    config.useFloat = single < chosen * (1.0 - TUNE_MIN_GAIN);
+    config.refillNs = refill * 1e9 / pixels;
+    config.lockstepNs = lockstep * 1e9 / pixels;
+    config.floatNs = single * 1e9 / pixels;
+
+    // Worker count, most threads first; fewer only if clearly faster
+    Viewport large = detail::tuneView(TUNE_POOL_WIDTH, TUNE_POOL_HEIGHT);
+    Precision precision = config.useFloat ? Precision::Float : Precision::Double;
+    double bestFrame = 0.0;
+    for (size_t i = counts.size(); i-- > 0;) {
+        double frame = detail::timePool(large, counts[i], config.layout, precision, slice);
+        if (config.threads == 0 || frame < bestFrame * (1.0 - TUNE_MIN_GAIN)) {
+            config.threads = counts[i];
+            bestFrame = frame;
+        }
+    }
+    config.frameMs = bestFrame * 1000.0;
+    config.tuneMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return config;
+}
+
+// Function to apply the float decision to a chosen precision
+inline Precision tunedPrecision(const TuneConfig& config, Precision precision) {
+    return precision == Precision::Float && !config.useFloat ? Precision::Double : precision;
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef BUDDHABROT_HPP
+#define BUDDHABROT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "fractal.hpp"
+
+// Buddhabrot / Nebulabrot renderer.
+//
+// Random c values are iterated under z^2 + c and the orbits of the points
+// that escape are accumulated into a density histogram. Every worker thread
+// owns a private histogram, so there is no contention while sampling; the
+// histograms are summed once at the end.
+//
+// With importance sampling enabled each worker runs a Metropolis-Hastings
+// chain whose stationary density is proportional to the number of orbit
+// points that land inside the view. Samples therefore concentrate near the
+// boundary where the long, visible orbits live. Every recorded orbit is
+// weighted by the inverse of its contribution, which keeps the expected
+// image identical to uniform sampling.
+
+// Number of color channels in a Nebulabrot (red, green, blue)
+const int NEBULA_CHANNELS = 3;
+
+// Samples a worker takes between checks for cancel()
+const long long BUDDHABROT_CANCEL_CHECK = 1024;
+
+struct BuddhabrotSettings {
+    // Iteration limit per channel; an orbit that escapes after n iterations
+    // is drawn into every channel whose limit is at least n
+    int maxIterations[NEBULA_CHANNELS];
+    // Orbits shorter than this are ignored (they only add a uniform haze)
+    int minIterations;
+    // Total number of c samples across all threads
+    long long samples;
+    int threads;
+    bool importanceSampling;
+    unsigned seed;
+
+    BuddhabrotSettings()
+        : minIterations(20), samples(2000000), threads(0),
+          importanceSampling(true), seed(1) {
+        maxIterations[0] = 5000;
+        maxIterations[1] = 500;
+        maxIterations[2] = 50;
+    }
+};
+
+class Buddhabrot {
+private:
+    Viewport view;
+    BuddhabrotSettings settings;
+    int longestOrbit;
+
+    // Merged histogram, channel-major: channel * width * height + y * width + x
+    std::vector<double> density;
+
+    // Set from another thread to stop render() early
+    std::atomic<bool> cancelled;
+
+    // Escape orbit of one c value
+    struct Orbit {
+        std::vector<double> real;
+        std::vector<double> imag;
+        int length;
+    };
+
+    // Per-thread sampling state
+    struct Worker {
+        std::vector<double> histogram;
+        Orbit current;
+        Orbit proposal;
+        std::mt19937_64 rng;
+    };
+
+    // Function to iterate c and store its orbit; the length is the escape
+    // iteration, or 0 if the point did not escape within the budget
+    void traceOrbit(Orbit& orbit, double cr, double ci) const {
+        orbit.length = 0;
+        if (inMainBulbs(cr, ci)) {
+            return;
+        }
+        double zr = cr;
+        double zi = ci;
+        for (int n = 0; n < longestOrbit; ++n) {
+            if (zr * zr + zi * zi > 4.0) {
+                orbit.length = n;
+                return;
+            }
+            orbit.real[n] = zr;
+            orbit.imag[n] = zi;
+            Multibrot<2>::step(zr, zi, cr, ci);
+        }
+    }
+
+    // Function to map a point to its pixel index, or -1 if it is off screen
+    int pixelIndex(double re, double im) const {
+        double fx = (re - view.centerReal) / view.pixelSize + view.width * 0.5;
+        double fy = (im - view.centerImag) / view.pixelSize + view.height * 0.5;
+        if (fx < 0.0 || fy < 0.0 || fx >= view.width || fy >= view.height) {
+            return -1;
+        }
+        return static_cast<int>(fy) * view.width + static_cast<int>(fx);
+    }
+
+    // Function to count how many orbit points land in the view
+    int contribution(const Orbit& orbit) const {
+        if (orbit.length < settings.minIterations) {
+            return 0;
+        }
+        int visible = 0;
+        for (int n = 0; n < orbit.length; ++n) {
+            visible += pixelIndex(orbit.real[n], orbit.imag[n]) >= 0;
+        }
+        return visible;
+    }
+
+    // Function to splat an orbit into a histogram
+    void accumulate(std::vector<double>& histogram, const Orbit& orbit, double weight) const {
+        if (orbit.length < settings.minIterations) {
+            return;
+        }
+        const int plane = view.width * view.height;
+        for (int n = 0; n < orbit.length; ++n) {
+            int index = pixelIndex(orbit.real[n], orbit.imag[n]);
+            if (index < 0) {
+                continue;
+            }
+            for (int channel = 0; channel < NEBULA_CHANNELS; ++channel) {
+                if (orbit.length <= settings.maxIterations[channel]) {
+                    histogram[channel * plane + index] += weight;
+                }
+            }
+        }
+    }
+
+    void sampleUniform(Worker& worker, long long samples) const {
+        std::uniform_real_distribution<double> coord(-2.0, 2.0);
+        for (long long s = 0; s < samples; ++s) {
+            if (s % BUDDHABROT_CANCEL_CHECK == 0 && cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            double cr = coord(worker.rng);
+            double ci = coord(worker.rng);
+            traceOrbit(worker.current, cr, ci);
+            accumulate(worker.histogram, worker.current, 1.0);
+        }
+    }
+
+    void sampleMetropolis(Worker& worker, long long samples) const {
+        std::uniform_real_distribution<double> coord(-2.0, 2.0);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::normal_distribution<double> gauss(0.0, 1.0);
+
+        // Mutation sizes span from sub-pixel to a tenth of the view
+        const double viewSpan = view.pixelSize * std::max(view.width, view.height);
+        const double minStep = std::log(view.pixelSize * 0.5);
+        const double maxStep = std::log(viewSpan * 0.1);
+
+        // Start the chain from any point whose orbit is visible
+        double cr = 0.0;
+        double ci = 0.0;
+        int current = 0;
+        for (long long tries = 0; tries < samples && current == 0; ++tries) {
+            cr = coord(worker.rng);
+            ci = coord(worker.rng);
+            traceOrbit(worker.current, cr, ci);
+            current = contribution(worker.current);
+        }
+        if (current == 0) {
+            return;
+        }
+
+        for (long long s = 0; s < samples; ++s) {
+            if (s % BUDDHABROT_CANCEL_CHECK == 0 && cancelled.load(std::memory_order_relaxed)) {
+                return;
+            }
+            double nr;
+            double ni;
+            if (unit(worker.rng) < 0.2) {
+                // Occasional independent jump keeps the chain ergodic
+                nr = coord(worker.rng);
+                ni = coord(worker.rng);
+            } else {
+                double step = std::exp(minStep + (maxStep - minStep) * unit(worker.rng));
+                nr = cr + step * gauss(worker.rng);
+                ni = ci + step * gauss(worker.rng);
+            }
+
+            traceOrbit(worker.proposal, nr, ni);
+            int proposed = contribution(worker.proposal);
+            if (proposed > 0 && unit(worker.rng) * current < proposed) {
+                cr = nr;
+                ci = ni;
+                current = proposed;
+                std::swap(worker.current, worker.proposal);
+            }
+            // A rejected proposal records the current state again
+            accumulate(worker.histogram, worker.current, 1.0 / current);
+        }
+    }
+
+    void runWorker(Worker& worker, long long samples) const {
+        if (settings.importanceSampling) {
+            sampleMetropolis(worker, samples);
+        } else {
+            sampleUniform(worker, samples);
+        }
+    }
+
+public:
+    Buddhabrot(const Viewport& viewport, const BuddhabrotSettings& buddhabrotSettings)
+        : view(viewport), settings(buddhabrotSettings), longestOrbit(0), cancelled(false) {
+        for (int channel = 0; channel < NEBULA_CHANNELS; ++channel) {
+            longestOrbit = std::max(longestOrbit, settings.maxIterations[channel]);
+        }
+        density.assign(static_cast<size_t>(NEBULA_CHANNELS) * view.width * view.height, 0.0);
+    }
+
+    // Function to sample the configured number of orbits on all threads
+    void render() {
+        int threadCount = settings.threads;
+        if (threadCount <= 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::vector<Worker> workers(threadCount);
+        for (int t = 0; t < threadCount; ++t) {
+            workers[t].histogram.assign(density.size(), 0.0);
+            workers[t].current.real.resize(longestOrbit);
+            workers[t].current.imag.resize(longestOrbit);
+            workers[t].proposal.real.resize(longestOrbit);
+            workers[t].proposal.imag.resize(longestOrbit);
+            workers[t].rng.seed(settings.seed * 7919u + t);
+        }
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threadCount; ++t) {
+            long long share = settings.samples / threadCount + (t < settings.samples % threadCount ? 1 : 0);
+            threads.emplace_back(&Buddhabrot::runWorker, this, std::ref(workers[t]), share);
+        }
+        for (size_t t = 0; t < threads.size(); ++t) {
+            threads[t].join();
+        }
+
+        // Merge the private histograms
+        for (int t = 0; t < threadCount; ++t) {
+            const std::vector<double>& histogram = workers[t].histogram;
+            for (size_t i = 0; i < density.size(); ++i) {
+                density[i] += histogram[i];
+            }
+        }
+    }
+
+    // Function to make a render() in progress on another thread return soon,
+    // with a partial histogram
+    void cancel() { cancelled.store(true); }
+
+    bool isCancelled() const { return cancelled.load(); }
+
+    // Function to tone-map the histogram into ARGB8888 pixels
+    void toPixels(uint32_t* out) const {
+        const int plane = view.width * view.height;
+        double scale[NEBULA_CHANNELS];
+        for (int channel = 0; channel < NEBULA_CHANNELS; ++channel) {
+            double peak = *std::max_element(density.begin() + channel * plane,
+                                            density.begin() + (channel + 1) * plane);
+            scale[channel] = peak > 0.0 ? 1.0 / std::sqrt(peak) : 0.0;
+        }
+
+        for (int i = 0; i < plane; ++i) {
+            uint32_t pixel = 0xFF000000u;
+            for (int channel = 0; channel < NEBULA_CHANNELS; ++channel) {
+                double v = std::sqrt(density[channel * plane + i]) * scale[channel];
+                uint32_t c = static_cast<uint32_t>(std::min(255.0, v * 255.0));
+                pixel |= c << (16 - 8 * channel);
+            }
+            out[i] = pixel;
+        }
+    }
+};
+
+#endif
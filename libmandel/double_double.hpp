@@ -0,0 +1,182 @@
+#ifndef DOUBLE_DOUBLE_HPP
+#define DOUBLE_DOUBLE_HPP
+
+// Double-double arithmetic: a value is the unevaluated sum hi + lo of two
+// doubles, giving about 106 bits of mantissa. Built only from plain double
+// adds and multiplies (Dekker's split, no FMA), so results do not depend on
+// whether the compiler contracts multiply-adds.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+struct DoubleDouble {
+    double hi;
+    double lo;
+
+    DoubleDouble() : hi(0.0), lo(0.0) {}
+    DoubleDouble(double value) : hi(value), lo(0.0) {}
+    DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+    double toDouble() const { return hi + lo; }
+};
+
+namespace dd {
+
+// a + b = s + err exactly
+inline DoubleDouble twoSum(double a, double b) {
+    double s = a + b;
+    double v = s - a;
+    double err = (a - (s - v)) + (b - v);
+    return DoubleDouble(s, err);
+}
+
+// a + b = s + err exactly, valid when |a| >= |b|
+inline DoubleDouble quickTwoSum(double a, double b) {
+    double s = a + b;
+    double err = b - (s - a);
+    return DoubleDouble(s, err);
+}
+
+// Split a into two 26-bit halves so their products are exact
+inline void split(double a, double& high, double& low) {
+    const double splitter = 134217729.0; // 2^27 + 1
+    double t = splitter * a;
+    high = t - (t - a);
+    low = a - high;
+}
+
+// a * b = p + err exactly
+inline DoubleDouble twoProd(double a, double b) {
+    double p = a * b;
+    double ah, al, bh, bl;
+    split(a, ah, al);
+    split(b, bh, bl);
+    double err = ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+    return DoubleDouble(p, err);
+}
+
+} // namespace dd
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble s = dd::twoSum(a.hi, b.hi);
+    DoubleDouble t = dd::twoSum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = dd::quickTwoSum(s.hi, s.lo);
+    s.lo += t.lo;
+    return dd::quickTwoSum(s.hi, s.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a) {
+    return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) {
+    return a + (-b);
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble p = dd::twoProd(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return dd::quickTwoSum(p.hi, p.lo);
+}
+
+inline DoubleDouble& operator+=(DoubleDouble& a, const DoubleDouble& b) {
+    a = a + b;
+    return a;
+}
+
+inline bool operator<=(const DoubleDouble& a, const DoubleDouble& b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo <= b.lo);
+}
+
+inline bool operator>(const DoubleDouble& a, const DoubleDouble& b) {
+    return !(a <= b);
+}
+
+inline DoubleDouble fabs(const DoubleDouble& a) {
+    return a.hi < 0.0 || (a.hi == 0.0 && a.lo < 0.0) ? -a : a;
+}
+
+// Function to divide by a double; the remainder is carried twice, so the
+// quotient keeps the full double-double precision
+inline DoubleDouble operator/(const DoubleDouble& a, double b) {
+    double q1 = a.hi / b;
+    DoubleDouble r = a - dd::twoProd(q1, b);
+    double q2 = r.hi / b;
+    r = r - dd::twoProd(q2, b);
+    double q3 = r.hi / b;
+    return dd::quickTwoSum(q1, q2) + DoubleDouble(q3);
+}
+
+// Function to parse a decimal number ("-0.74364388703715870475", "1e-20")
+// to full double-double precision, where strtod would round to a double.
+// Returns false unless the whole text is a number.
+inline bool parseDoubleDouble(const char* text, DoubleDouble& value) {
+    // Decimal digits double-double can hold; later ones only move the exponent
+    const int significantDigits = 34;
+    // Largest power of ten a double holds exactly
+    const double exactPower = 1e22;
+    const int exactDigits = 22;
+
+    bool negative = *text == '-';
+    if (*text == '-' || *text == '+') {
+        text++;
+    }
+    DoubleDouble mantissa;
+    int digits = 0;
+    int exponent = 0;
+    bool fraction = false;
+    bool any = false;
+    for (;; ++text) {
+        if (*text == '.' && !fraction) {
+            fraction = true;
+        } else if (*text >= '0' && *text <= '9') {
+            any = true;
+            if (digits < significantDigits) {
+                if (digits > 0 || *text != '0') {
+                    mantissa = mantissa * DoubleDouble(10.0) + DoubleDouble(*text - '0');
+                    digits++;
+                }
+                exponent -= fraction ? 1 : 0;
+            } else {
+                exponent += fraction ? 0 : 1;
+            }
+        } else {
+            break;
+        }
+    }
+    if (!any) {
+        return false;
+    }
+    if (*text == 'e' || *text == 'E') {
+        text++;
+        bool negativeExponent = *text == '-';
+        if (*text == '-' || *text == '+') {
+            text++;
+        }
+        if (*text < '0' || *text > '9') {
+            return false;
+        }
+        int written = 0;
+        while (*text >= '0' && *text <= '9') {
+            written = std::min(written * 10 + (*text - '0'), 100000);
+            text++;
+        }
+        exponent += negativeExponent ? -written : written;
+    }
+    if (*text != '\0') {
+        return false;
+    }
+
+    while (exponent != 0) {
+        int step = std::min(std::abs(exponent), exactDigits);
+        double power = step == exactDigits ? exactPower : std::pow(10.0, step);
+        mantissa = exponent > 0 ? mantissa * DoubleDouble(power) : mantissa / power;
+        exponent += exponent > 0 ? -step : step;
+    }
+    value = negative ? -mantissa : mantissa;
+    return true;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef FIXED_POINT_HPP
+#define FIXED_POINT_HPP
+
+#include <cmath>
+#include <cstdint>
+
+#include "double_double.hpp"
+#include "fractal.hpp"
+
+// Q4.59 fixed-point number: one sign bit, four integer bits and 59 fraction
+// bits in an int64_t. Every operation is integer arithmetic with truncating
+// (floor) shifts, so iteration counts are bit-identical on every host,
+// compiler and thread count, whether or not the compiler emits FMA.
+//
+// Products are formed in 128 bits and truncated back to 64. While |z| <= 2
+// no degree-2 formula leaves the +-16 range; lanes that have escaped may
+// wrap around, but the lane kernels freeze those lanes and the escape test
+// below bounds both components before squaring, so a wrapped value is never
+// used. Higher Multibrot powers overflow the integer bits and are not
+// supported (see supportsFixedPoint()).
+
+struct Fixed {
+    int64_t raw;
+
+    static const int FRACTION_BITS = 59;
+
+    Fixed() : raw(0) {}
+    // Integers only: a double must go through fromDouble(), as converting it
+    // here would silently truncate the fraction
+    explicit Fixed(int value) : raw(static_cast<int64_t>(value) * (static_cast<int64_t>(1) << FRACTION_BITS)) {}
+    Fixed(double value) = delete;
+
+    static Fixed fromRaw(int64_t value) {
+        Fixed f;
+        f.raw = value;
+        return f;
+    }
+
+    // Scaling by a power of two is exact, and llround is fully specified
+    static Fixed fromDouble(double value) {
+        return fromRaw(std::llround(std::ldexp(value, FRACTION_BITS)));
+    }
+
+    double toDouble() const { return std::ldexp(static_cast<double>(raw), -FRACTION_BITS); }
+};
+
+// Adds go through uint64_t so a wrapped (escaped) lane is not undefined behaviour
+inline Fixed operator+(Fixed a, Fixed b) {
+    return Fixed::fromRaw(static_cast<int64_t>(static_cast<uint64_t>(a.raw) + static_cast<uint64_t>(b.raw)));
+}
+inline Fixed operator-(Fixed a, Fixed b) {
+    return Fixed::fromRaw(static_cast<int64_t>(static_cast<uint64_t>(a.raw) - static_cast<uint64_t>(b.raw)));
+}
+inline Fixed operator-(Fixed a) { return Fixed() - a; }
+
+inline Fixed operator*(Fixed a, Fixed b) {
+    __int128 product = static_cast<__int128>(a.raw) * b.raw;
+    return Fixed::fromRaw(static_cast<int64_t>(product >> Fixed::FRACTION_BITS));
+}
+
+inline Fixed& operator+=(Fixed& a, Fixed b) {
+    a = a + b;
+    return a;
+}
+
+inline bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+inline bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+
+inline Fixed fabs(Fixed a) { return a.raw < 0 ? -a : a; }
+
+// |z|^2 <= 4 without squaring out of range: components beyond +-2 have
+// escaped already, and within +-2 the squares sum to at most 8
+inline bool insideEscapeRadius(Fixed zr, Fixed zi) {
+    const int64_t two = static_cast<int64_t>(2) << Fixed::FRACTION_BITS;
+    bool bounded = (zr.raw <= two) & (zr.raw >= -two) & (zi.raw <= two) & (zi.raw >= -two);
+    return bounded & ((zr * zr + zi * zi).raw <= 2 * two);
+}
+
+// Pixel coordinates are derived from the center and spacing in integer
+// arithmetic too, so no floating-point rounding reaches the kernel
+template <>
+struct PixelCoords<Fixed> {
+    static Fixed axis(double center, double centerLo, double pixelSize, int index, int size) {
+        Fixed origin = Fixed::fromDouble(center) + Fixed::fromDouble(centerLo);
+        int64_t step = Fixed::fromDouble(pixelSize).raw;
+        return Fixed::fromRaw(origin.raw + ((2 * static_cast<int64_t>(index) - size) * step) / 2);
+    }
+    static Fixed real(const Viewport& view, int x) {
+        return axis(view.centerReal, view.centerRealLo, view.pixelSize, x, view.width);
+    }
+    static Fixed imag(const Viewport& view, int y) {
+        return axis(view.centerImag, view.centerImagLo, view.pixelSize, y, view.height);
+    }
+    static Fixed constant(double value) { return Fixed::fromDouble(value); }
+};
+
+// Only degree-2 formulas stay within the integer bits
+inline bool supportsFixedPoint(const FractalParams& params) {
+    return params.formula != FormulaKind::Multibrot || params.power == 2;
+}
+
+// Smallest pixel spacing fixed point resolves. The resolution is absolute
+// (2^-59), so this is 59 fraction bits less the 20 guard bits double keeps.
+const double FIXED_MIN_PIXEL_SIZE = 1.0 / 549755813888.0; // 2^-39
+
+#endif
@@ -0,0 +1,621 @@
+#ifndef FRACTAL_HPP
+#define FRACTAL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "double_double.hpp"
+
+// Escape-time fractal engine.
+//
+// The formula, exponent, Julia/Mandelbrot mode and number type are all
+// template parameters, so every variant gets its own straight-line inner
+// loop with no per-iteration branching. The viewer picks one specialization
+// per frame through selectRectKernel() (or selectRowKernel() for the plain
+// lockstep kernel) and then calls it for every region of the frame.
+
+// Which recurrence the escape-time loop iterates
+enum class FormulaKind {
+    Multibrot,   // z^p + c (p = 2 is the classic Mandelbrot set)
+    BurningShip, // (|Re z| + i|Im z|)^2 + c
+    Tricorn      // conj(z)^2 + c
+};
+
+// Smallest and largest Multibrot exponent that has a compiled specialization
+const int MIN_POWER = 2;
+const int MAX_POWER = 8;
+
+// Number of pixels iterated side by side by the lane kernels
+const int KERNEL_LANES = 8;
+
+// How the rectangle kernels spread pixels over the lanes. Which is faster
+// depends on the CPU (see autotune.hpp); both give identical results.
+enum class LaneLayout {
+    Refill,  // lanes refill from a pixel queue as they finish (renderRectQueued)
+    Lockstep // KERNEL_LANES row neighbours run until the slowest is done
+};
+
+// Iterations the queue kernel runs between checks for finished lanes
+const int REFILL_BLOCK = 8;
+
+// Lanes used by the queue kernel; single precision fits twice as many
+// values per SIMD register
+template <typename T>
+struct LaneWidth {
+    static const int value = KERNEL_LANES;
+};
+
+template <>
+struct LaneWidth<float> {
+    static const int value = 2 * KERNEL_LANES;
+};
+
+// Runtime description of a fractal, chosen by the user
+struct FractalParams {
+    FormulaKind formula;
+    int power;
+    bool julia;
+    double juliaReal;
+    double juliaImag;
+
+    FractalParams()
+        : formula(FormulaKind::Multibrot), power(2), julia(false),
+          juliaReal(-0.8), juliaImag(0.156) {}
+};
+
+// Region of the complex plane mapped onto a width x height pixel grid.
+// The center is kept in double-double (hi + lo) so deep zooms stay exact;
+// code that only needs double precision reads the hi parts directly.
+struct Viewport {
+    double centerReal;
+    double centerImag;
+    double centerRealLo;
+    double centerImagLo;
+    double pixelSize;
+    int width;
+    int height;
+
+    Viewport(int w, int h)
+        : centerReal(-0.5), centerImag(0.0), centerRealLo(0.0), centerImagLo(0.0),
+          pixelSize(3.0 / h), width(w), height(h) {}
+
+    double pixelReal(int x) const { return centerReal + (x - width * 0.5) * pixelSize; }
+    double pixelImag(int y) const { return centerImag + (y - height * 0.5) * pixelSize; }
+
+    DoubleDouble pixelRealDD(int x) const {
+        return DoubleDouble(centerReal, centerRealLo) + dd::twoProd(x - width * 0.5, pixelSize);
+    }
+    DoubleDouble pixelImagDD(int y) const {
+        return DoubleDouble(centerImag, centerImagLo) + dd::twoProd(y - height * 0.5, pixelSize);
+    }
+
+    // Move the center to pixel (x, y)
+    void centerOn(int x, int y) {
+        DoubleDouble re = pixelRealDD(x);
+        DoubleDouble im = pixelImagDD(y);
+        centerReal = re.hi;
+        centerRealLo = re.lo;
+        centerImag = im.hi;
+        centerImagLo = im.lo;
+    }
+
+    // Scale the pixel size by factor while pixel (x, y) stays in place
+    void zoomAt(int x, int y, double factor) {
+        DoubleDouble re = pixelRealDD(x);
+        DoubleDouble im = pixelImagDD(y);
+        pixelSize *= factor;
+        re = re - dd::twoProd(x - width * 0.5, pixelSize);
+        im = im - dd::twoProd(y - height * 0.5, pixelSize);
+        centerReal = re.hi;
+        centerRealLo = re.lo;
+        centerImag = im.hi;
+        centerImagLo = im.lo;
+    }
+
+    // Find where pixel (x, y) of this view lies in the pixels of another
+    // view. The centers are subtracted in double-double, so this stays
+    // accurate at any zoom depth.
+    void mapTo(const Viewport& other, double x, double y, double& otherX, double& otherY) const {
+        double deltaReal = (DoubleDouble(centerReal, centerRealLo) -
+                            DoubleDouble(other.centerReal, other.centerRealLo)).toDouble();
+        double deltaImag = (DoubleDouble(centerImag, centerImagLo) -
+                            DoubleDouble(other.centerImag, other.centerImagLo)).toDouble();
+        otherX = (deltaReal + (x - width * 0.5) * pixelSize) / other.pixelSize + other.width * 0.5;
+        otherY = (deltaImag + (y - height * 0.5) * pixelSize) / other.pixelSize + other.height * 0.5;
+    }
+};
+
+// Pixel coordinates, and constants such as the Julia parameter, in the
+// number type a kernel iterates with
+template <typename T>
+struct PixelCoords {
+    static T real(const Viewport& view, int x) { return static_cast<T>(view.pixelReal(x)); }
+    static T imag(const Viewport& view, int y) { return static_cast<T>(view.pixelImag(y)); }
+    static T constant(double value) { return static_cast<T>(value); }
+};
+
+template <>
+struct PixelCoords<DoubleDouble> {
+    static DoubleDouble real(const Viewport& view, int x) { return view.pixelRealDD(x); }
+    static DoubleDouble imag(const Viewport& view, int y) { return view.pixelImagDD(y); }
+    static DoubleDouble constant(double value) { return DoubleDouble(value); }
+};
+
+// Complex integer power z^P, unrolled at compile time
+template <typename T, int P>
+struct ComplexPower {
+    static inline void apply(T& re, T& im) {
+        T r = re;
+        T i = im;
+        ComplexPower<T, P - 1>::apply(r, i);
+        T newRe = r * re - i * im;
+        T newIm = r * im + i * re;
+        re = newRe;
+        im = newIm;
+    }
+};
+
+template <typename T>
+struct ComplexPower<T, 1> {
+    static inline void apply(T&, T&) {}
+};
+
+// z^P + c
+template <int P>
+struct Multibrot {
+    template <typename T>
+    static inline void step(T& zr, T& zi, T cr, T ci) {
+        ComplexPower<T, P>::apply(zr, zi);
+        zr += cr;
+        zi += ci;
+    }
+};
+
+// The common case gets the three-multiply form
+template <>
+struct Multibrot<2> {
+    template <typename T>
+    static inline void step(T& zr, T& zi, T cr, T ci) {
+        T newReal = zr * zr - zi * zi + cr;
+        T newImag = T(2) * zr * zi + ci;
+        zr = newReal;
+        zi = newImag;
+    }
+};
+
+struct BurningShip {
+    template <typename T>
+    static inline void step(T& zr, T& zi, T cr, T ci) {
+        using std::fabs;
+        T ar = fabs(zr);
+        T ai = fabs(zi);
+        zr = ar * ar - ai * ai + cr;
+        zi = T(2) * ar * ai + ci;
+    }
+};
+
+struct Tricorn {
+    template <typename T>
+    static inline void step(T& zr, T& zi, T cr, T ci) {
+        T newReal = zr * zr - zi * zi + cr;
+        T newImag = T(-2) * zr * zi + ci;
+        zr = newReal;
+        zi = newImag;
+    }
+};
+
+// Escape test |z| <= 2. Number types that cannot square arbitrary values
+// provide their own overload, found by argument-dependent lookup.
+template <typename T>
+inline bool insideEscapeRadius(T zr, T zi) {
+    return zr * zr + zi * zi <= T(4);
+}
+
+// Iterations until |z| > 2, starting from z = (x, y).
+// Mandelbrot mode uses c = (x, y); Julia mode uses the fixed c = (kr, ki).
+template <typename Formula, bool Julia, typename T>
+inline int escapeTime(T x, T y, T kr, T ki, int maxIterations) {
+    T cr = Julia ? kr : x;
+    T ci = Julia ? ki : y;
+    T zr = x;
+    T zi = y;
+    int iterations = 0;
+
+    while (iterations < maxIterations && insideEscapeRadius(zr, zi)) {
+        Formula::step(zr, zi, cr, ci);
+        iterations++;
+    }
+
+    return iterations;
+}
+
+// Iterate KERNEL_LANES pixels of one row in lockstep. The loops over the
+// fixed-size lane arrays are what the compiler turns into SIMD code; escaped
+// lanes are frozen rather than branched around.
+template <typename Formula, bool Julia, typename T>
+inline void escapeTimeLanes(const T* xs, T y, T kr, T ki, int maxIterations, int* out) {
+    T zr[KERNEL_LANES], zi[KERNEL_LANES], cr[KERNEL_LANES], ci[KERNEL_LANES];
+    int count[KERNEL_LANES];
+
+    for (int k = 0; k < KERNEL_LANES; ++k) {
+        zr[k] = xs[k];
+        zi[k] = y;
+        cr[k] = Julia ? kr : xs[k];
+        ci[k] = Julia ? ki : y;
+        count[k] = 0;
+    }
+
+    for (int i = 0; i < maxIterations; ++i) {
+        int active = 0;
+        for (int k = 0; k < KERNEL_LANES; ++k) {
+            bool inside = insideEscapeRadius(zr[k], zi[k]);
+            T r = zr[k];
+            T im = zi[k];
+            Formula::step(r, im, cr[k], ci[k]);
+            zr[k] = inside ? r : zr[k];
+            zi[k] = inside ? im : zi[k];
+            count[k] += inside;
+            active |= inside;
+        }
+        if (!active) {
+            break;
+        }
+    }
+
+    for (int k = 0; k < KERNEL_LANES; ++k) {
+        out[k] = count[k];
+    }
+}
+
+// Render pixels [x0, x1) of row y into out[0 .. x1 - x0)
+template <typename Formula, bool Julia, typename T>
+void renderRowSpan(const Viewport& view, const FractalParams& params,
+                   int y, int x0, int x1, int maxIterations, int* out) {
+    const T py = PixelCoords<T>::imag(view, y);
+    const T kr = PixelCoords<T>::constant(params.juliaReal);
+    const T ki = PixelCoords<T>::constant(params.juliaImag);
+
+    int x = x0;
+    T xs[KERNEL_LANES];
+    for (; x + KERNEL_LANES <= x1; x += KERNEL_LANES) {
+        for (int k = 0; k < KERNEL_LANES; ++k) {
+            xs[k] = PixelCoords<T>::real(view, x + k);
+        }
+        escapeTimeLanes<Formula, Julia, T>(xs, py, kr, ki, maxIterations, out + (x - x0));
+    }
+    for (; x < x1; ++x) {
+        T px = PixelCoords<T>::real(view, x);
+        out[x - x0] = escapeTime<Formula, Julia, T>(px, py, kr, ki, maxIterations);
+    }
+}
+
+// Render pixels [x0, x1) of row y one pixel at a time with the specialized
+// loop. Not chosen by the dispatcher; the benchmarks compare it against
+// renderRowSpanDynamic() to measure specialization apart from the lanes.
+template <typename Formula, bool Julia, typename T>
+void renderRowSpanScalar(const Viewport& view, const FractalParams& params,
+                         int y, int x0, int x1, int maxIterations, int* out) {
+    const T py = PixelCoords<T>::imag(view, y);
+    const T kr = PixelCoords<T>::constant(params.juliaReal);
+    const T ki = PixelCoords<T>::constant(params.juliaImag);
+    for (int x = x0; x < x1; ++x) {
+        out[x - x0] = escapeTime<Formula, Julia, T>(PixelCoords<T>::real(view, x), py, kr, ki, maxIterations);
+    }
+}
+
+// Function to tell whether c lies in the main cardioid or the period-2
+// bulb of the Mandelbrot set: such points never escape, and would burn the
+// full iteration budget
+inline bool inMainBulbs(double cr, double ci) {
+    double q = (cr - 0.25) * (cr - 0.25) + ci * ci;
+    if (q * (q + (cr - 0.25)) <= 0.25 * ci * ci) {
+        return true;
+    }
+    return (cr + 1.0) * (cr + 1.0) + ci * ci <= 0.0625;
+}
+
+// Closest two orbit points may come before the periodicity check takes the
+// orbit as cycling, relative to the number type's epsilon
+const double PERIODICITY_TOLERANCE = 4.0;
+
+// Escape time of c = (x, y) under z^2 + c, one pixel at a time, with
+// optional shortcuts for interior points: the cardioid/bulb test answers
+// maxIterations up front, and the periodicity check (Brent's method: compare
+// against a saved point, re-saved at doubling intervals) stops once the
+// orbit returns to where it was. Both give the plain loop's answer except
+// for the rare boundary pixel whose orbit lingers within the tolerance.
+template <bool Cardioid, bool Periodicity, typename T>
+inline int escapeTimeChecked(T x, T y, int maxIterations) {
+    if (Cardioid && inMainBulbs(x, y)) {
+        return maxIterations;
+    }
+    const T tolerance = std::numeric_limits<T>::epsilon() * T(PERIODICITY_TOLERANCE);
+    T zr = x;
+    T zi = y;
+    T savedReal = zr;
+    T savedImag = zi;
+    int period = 8;
+    int iterations = 0;
+
+    while (iterations < maxIterations && zr * zr + zi * zi <= T(4)) {
+        T newReal = zr * zr - zi * zi + x;
+        zi = T(2) * zr * zi + y;
+        zr = newReal;
+        iterations++;
+        if (Periodicity) {
+            if (std::fabs(zr - savedReal) <= tolerance && std::fabs(zi - savedImag) <= tolerance) {
+                return maxIterations;
+            }
+            if (iterations == period) {
+                savedReal = zr;
+                savedImag = zi;
+                period *= 2;
+            }
+        }
+    }
+
+    return iterations;
+}
+
+// Render pixels [x0, x1) of row y of the Mandelbrot set (z^2 + c only) with
+// the one-pixel-at-a-time checked loop. Not chosen by the dispatcher; the
+// benchmarks compare it against the lane kernels.
+template <bool Cardioid, bool Periodicity, typename T>
+void renderRowSpanChecked(const Viewport& view, const FractalParams& params,
+                          int y, int x0, int x1, int maxIterations, int* out) {
+    (void)params;
+    const T py = PixelCoords<T>::imag(view, y);
+    for (int x = x0; x < x1; ++x) {
+        out[x - x0] = escapeTimeChecked<Cardioid, Periodicity, T>(PixelCoords<T>::real(view, x), py,
+                                                                  maxIterations);
+    }
+}
+
+// Lane occupancy of a kernel run: iterations that advanced a pixel versus
+// iteration slots the lanes spent, including idle and already-escaped lanes
+struct LaneStats {
+    long long usefulIterations;
+    long long laneSlots;
+
+    LaneStats() : usefulIterations(0), laneSlots(0) {}
+
+    double utilization() const {
+        return laneSlots > 0 ? static_cast<double>(usefulIterations) / laneSlots : 0.0;
+    }
+};
+
+// Render the rectangle [x0, x1) x [y0, y1) into out (row stride outStride)
+// with a streaming lane kernel. Pixels are pulled from a queue in row-major
+// order; whenever a lane escapes or reaches maxIterations its result is
+// retired and the next pending pixel is loaded into that lane, so one slow
+// pixel never holds the other lanes idle.
+template <typename Formula, bool Julia, typename T>
+void renderRectQueued(const Viewport& view, const FractalParams& params,
+                      int x0, int y0, int x1, int y1, int maxIterations,
+                      int* out, int outStride, LaneStats* stats) {
+    const int rectWidth = x1 - x0;
+    const int pending = rectWidth * (y1 - y0);
+    const T kr = PixelCoords<T>::constant(params.juliaReal);
+    const T ki = PixelCoords<T>::constant(params.juliaImag);
+
+    const int lanes = LaneWidth<T>::value;
+    T zr[lanes], zi[lanes], cr[lanes], ci[lanes];
+    int count[lanes];
+    int pixel[lanes];
+    int next = 0;
+    int busy = 0;
+    long long blocks = 0;
+    long long useful = 0;
+
+    // Load the next queued pixel into lane k, or park the lane if the queue is empty
+    auto load = [&](int k) {
+        if (next < pending) {
+            int px = x0 + next % rectWidth;
+            int py = y0 + next / rectWidth;
+            zr[k] = PixelCoords<T>::real(view, px);
+            zi[k] = PixelCoords<T>::imag(view, py);
+            cr[k] = Julia ? kr : zr[k];
+            ci[k] = Julia ? ki : zi[k];
+            count[k] = 0;
+            pixel[k] = next++;
+            busy++;
+        } else {
+            zr[k] = zi[k] = cr[k] = ci[k] = T(0);
+            count[k] = maxIterations;
+            pixel[k] = -1;
+        }
+    };
+
+    for (int k = 0; k < lanes; ++k) {
+        load(k);
+    }
+
+    while (busy > 0) {
+        for (int b = 0; b < REFILL_BLOCK; ++b) {
+            for (int k = 0; k < lanes; ++k) {
+                // Non-short-circuit & keeps the loop body branch-free
+                bool inside = insideEscapeRadius(zr[k], zi[k]) & (count[k] < maxIterations);
+                T r = zr[k];
+                T im = zi[k];
+                Formula::step(r, im, cr[k], ci[k]);
+                zr[k] = inside ? r : zr[k];
+                zi[k] = inside ? im : zi[k];
+                count[k] += inside;
+            }
+        }
+        blocks++;
+
+        // Retire finished lanes and refill them from the queue
+        for (int k = 0; k < lanes; ++k) {
+            if (pixel[k] < 0) {
+                continue;
+            }
+            if (count[k] >= maxIterations || !insideEscapeRadius(zr[k], zi[k])) {
+                int px = pixel[k] % rectWidth;
+                int py = pixel[k] / rectWidth;
+                out[py * outStride + px] = count[k];
+                useful += count[k];
+                busy--;
+                load(k);
+            }
+        }
+    }
+
+    if (stats) {
+        stats->usefulIterations += useful;
+        stats->laneSlots += blocks * REFILL_BLOCK * lanes;
+    }
+}
+
+// Render the rectangle [x0, x1) x [y0, y1) row by row with the lockstep
+// kernel. Lane slots are counted as the lanes spend them: each group of
+// KERNEL_LANES pixels runs as long as its slowest pixel.
+template <typename Formula, bool Julia, typename T>
+void renderRectLockstep(const Viewport& view, const FractalParams& params,
+                        int x0, int y0, int x1, int y1, int maxIterations,
+                        int* out, int outStride, LaneStats* stats) {
+    for (int y = y0; y < y1; ++y) {
+        int* row = out + (y - y0) * outStride;
+        renderRowSpan<Formula, Julia, T>(view, params, y, x0, x1, maxIterations, row);
+        if (stats == nullptr) {
+            continue;
+        }
+        for (int x = 0; x < x1 - x0; x += KERNEL_LANES) {
+            int slowest = 0;
+            for (int k = x; k < std::min(x + KERNEL_LANES, x1 - x0); ++k) {
+                stats->usefulIterations += row[k];
+                slowest = std::max(slowest, row[k]);
+            }
+            stats->laneSlots += static_cast<long long>(slowest) * KERNEL_LANES;
+        }
+    }
+}
+
+// A fully specialized span renderer
+typedef void (*RowKernel)(const Viewport& view, const FractalParams& params,
+                          int y, int x0, int x1, int maxIterations, int* out);
+
+// A fully specialized rectangle renderer
+typedef void (*RectKernel)(const Viewport& view, const FractalParams& params,
+                           int x0, int y0, int x1, int y1, int maxIterations,
+                           int* out, int outStride, LaneStats* stats);
+
+// Kernel families the dispatcher can resolve to a specialization
+struct RowKernels {
+    typedef RowKernel Kernel;
+    template <typename Formula, bool Julia, typename T>
+    static Kernel get() { return &renderRowSpan<Formula, Julia, T>; }
+};
+
+struct ScalarRowKernels {
+    typedef RowKernel Kernel;
+    template <typename Formula, bool Julia, typename T>
+    static Kernel get() { return &renderRowSpanScalar<Formula, Julia, T>; }
+};
+
+struct QueuedKernels {
+    typedef RectKernel Kernel;
+    template <typename Formula, bool Julia, typename T>
+    static Kernel get() { return &renderRectQueued<Formula, Julia, T>; }
+};
+
+struct LockstepKernels {
+    typedef RectKernel Kernel;
+    template <typename Formula, bool Julia, typename T>
+    static Kernel get() { return &renderRectLockstep<Formula, Julia, T>; }
+};
+
+namespace detail {
+
+template <typename Family, typename T, bool Julia>
+typename Family::Kernel selectMultibrot(int power) {
+    switch (power) {
+        case 3: return Family::template get<Multibrot<3>, Julia, T>();
+        case 4: return Family::template get<Multibrot<4>, Julia, T>();
+        case 5: return Family::template get<Multibrot<5>, Julia, T>();
+        case 6: return Family::template get<Multibrot<6>, Julia, T>();
+        case 7: return Family::template get<Multibrot<7>, Julia, T>();
+        case 8: return Family::template get<Multibrot<8>, Julia, T>();
+        default: return Family::template get<Multibrot<2>, Julia, T>();
+    }
+}
+
+template <typename Family, typename T, bool Julia>
+typename Family::Kernel selectFormula(const FractalParams& params) {
+    switch (params.formula) {
+        case FormulaKind::BurningShip: return Family::template get<BurningShip, Julia, T>();
+        case FormulaKind::Tricorn: return Family::template get<Tricorn, Julia, T>();
+        default: return selectMultibrot<Family, T, Julia>(params.power);
+    }
+}
+
+template <typename Family, typename T>
+typename Family::Kernel select(const FractalParams& params) {
+    return params.julia ? selectFormula<Family, T, true>(params)
+                        : selectFormula<Family, T, false>(params);
+}
+
+} // namespace detail
+
+// Resolve the runtime parameters to a compiled specialization once per frame
+template <typename T>
+RowKernel selectRowKernel(const FractalParams& params) {
+    return detail::select<RowKernels, T>(params);
+}
+
+template <typename T>
+RowKernel selectScalarRowKernel(const FractalParams& params) {
+    return detail::select<ScalarRowKernels, T>(params);
+}
+
+template <typename T>
+RectKernel selectRectKernel(const FractalParams& params, LaneLayout layout = LaneLayout::Refill) {
+    return layout == LaneLayout::Lockstep ? detail::select<LockstepKernels, T>(params)
+                                          : detail::select<QueuedKernels, T>(params);
+}
+
+// Reference implementation that decides formula, power and mode inside the
+// iteration loop. Only used to measure what the specializations save.
+inline int escapeTimeDynamic(const FractalParams& params, double x, double y, int maxIterations) {
+    double cr = params.julia ? params.juliaReal : x;
+    double ci = params.julia ? params.juliaImag : y;
+    double zr = x;
+    double zi = y;
+    int iterations = 0;
+
+    while (iterations < maxIterations && zr * zr + zi * zi <= 4.0) {
+        double r = zr;
+        double i = zi;
+        if (params.formula == FormulaKind::BurningShip) {
+            r = std::fabs(r);
+            i = std::fabs(i);
+        }
+        int power = params.formula == FormulaKind::Multibrot ? params.power : 2;
+        double pr = r;
+        double pi = i;
+        for (int p = 1; p < power; ++p) {
+            double t = pr * r - pi * i;
+            pi = pr * i + pi * r;
+            pr = t;
+        }
+        if (params.formula == FormulaKind::Tricorn) {
+            pi = -pi;
+        }
+        zr = pr + cr;
+        zi = pi + ci;
+        iterations++;
+    }
+
+    return iterations;
+}
+
+inline void renderRowSpanDynamic(const Viewport& view, const FractalParams& params,
+                                 int y, int x0, int x1, int maxIterations, int* out) {
+    double py = view.pixelImag(y);
+    for (int x = x0; x < x1; ++x) {
+        out[x - x0] = escapeTimeDynamic(params, view.pixelReal(x), py, maxIterations);
+    }
+}
+
+#endif
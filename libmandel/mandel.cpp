@@ -0,0 +1,189 @@
+// C API of the fractal core (see mandel.h), on top of the C++ kernels and
+// the tile scheduler's thread pool
+#include "mandel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+#include "fractal.hpp"
+#include "precision.hpp"
+#include "tile_scheduler.hpp"
+
+struct mandel_context {
+    TileScheduler scheduler;
+
+    // Set by the workers' wake callback, cleared before each drain
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool woken;
+
+    int lastPrecision;
+    std::string error;
+
+    mandel_context() : woken(false), lastPrecision(MANDEL_PRECISION_DOUBLE) {}
+};
+
+// Function to check a request, and say what is wrong with it
+static const char* validateRequest(const mandel_request* request) {
+    if (request->width <= 0 || request->height <= 0) {
+        return "width and height must be positive";
+    }
+    if (request->max_iterations <= 0) {
+        return "max_iterations must be positive";
+    }
+    if (!(request->pixel_size > 0.0) || !std::isfinite(request->pixel_size)) {
+        return "pixel_size must be positive and finite";
+    }
+    if (request->formula < MANDEL_MULTIBROT || request->formula > MANDEL_TRICORN) {
+        return "unknown formula";
+    }
+    if (request->formula == MANDEL_MULTIBROT && (request->power < MIN_POWER || request->power > MAX_POWER)) {
+        return "Multibrot power out of range";
+    }
+    if (request->precision < MANDEL_PRECISION_AUTO || request->precision > MANDEL_PRECISION_FIXED_POINT) {
+        return "unknown precision";
+    }
+    return nullptr;
+}
+
+extern "C" {
+
+void mandel_request_init(mandel_request* request, int width, int height) {
+    FractalParams params;
+    Viewport view(width, height);
+    request->width = width;
+    request->height = height;
+    request->center_real = view.centerReal;
+    request->center_imag = view.centerImag;
+    request->center_real_lo = 0.0;
+    request->center_imag_lo = 0.0;
+    request->pixel_size = view.pixelSize;
+    request->max_iterations = 1000;
+    request->formula = MANDEL_MULTIBROT;
+    request->power = params.power;
+    request->julia = 0;
+    request->julia_real = params.juliaReal;
+    request->julia_imag = params.juliaImag;
+    request->precision = MANDEL_PRECISION_AUTO;
+}
+
+mandel_context* mandel_create(int threads) {
+    mandel_context* context = new (std::nothrow) mandel_context();
+    if (context == nullptr) {
+        return nullptr;
+    }
+    try {
+        context->scheduler.setWakeCallback([context] {
+            std::lock_guard<std::mutex> lock(context->mutex);
+            context->woken = true;
+            context->ready.notify_one();
+        });
+        context->scheduler.start(threads);
+    } catch (...) {
+        delete context;
+        return nullptr;
+    }
+    return context;
+}
+
+void mandel_destroy(mandel_context* context) {
+    delete context;
+}
+
+int mandel_thread_count(const mandel_context* context) {
+    return context->scheduler.threadCount();
+}
+
+int mandel_render(mandel_context* context, const mandel_request* request, int* iterations) {
+    const char* problem = validateRequest(request);
+    if (problem != nullptr) {
+        context->error = problem;
+        return -1;
+    }
+
+    try {
+        Viewport view(request->width, request->height);
+        view.centerReal = request->center_real;
+        view.centerImag = request->center_imag;
+        view.centerRealLo = request->center_real_lo;
+        view.centerImagLo = request->center_imag_lo;
+        view.pixelSize = request->pixel_size;
+
+        FractalParams params;
+        params.formula = static_cast<FormulaKind>(request->formula);
+        params.power = request->formula == MANDEL_MULTIBROT ? request->power : 2;
+        params.julia = request->julia != 0;
+        params.juliaReal = request->julia_real;
+        params.juliaImag = request->julia_imag;
+
+        Precision precision = request->precision == MANDEL_PRECISION_AUTO
+                                  ? choosePrecision(view, params)
+                                  : static_cast<Precision>(request->precision);
+
+        int generation = context->scheduler.submit(view, params, request->max_iterations, precision);
+        int remaining = context->scheduler.tileCount(generation);
+        while (remaining > 0) {
+            {
+                std::unique_lock<std::mutex> lock(context->mutex);
+                context->ready.wait(lock, [context] { return context->woken; });
+                context->woken = false;
+            }
+            while (remaining > 0 && context->scheduler.popCompleted() != nullptr) {
+                remaining--;
+            }
+        }
+
+        const int* result = context->scheduler.iterations(generation);
+        std::copy(result, result + static_cast<size_t>(request->width) * request->height, iterations);
+        context->lastPrecision = static_cast<int>(context->scheduler.precision(generation));
+    } catch (const std::bad_alloc&) {
+        context->error = "out of memory";
+        return -1;
+    }
+    return 0;
+}
+
+int mandel_last_precision(const mandel_context* context) {
+    return context->lastPrecision;
+}
+
+const char* mandel_version(void) {
+    return MANDEL_VERSION;
+}
+
+const char* mandel_precision_name(int precision) {
+    if (precision < MANDEL_PRECISION_FLOAT || precision > MANDEL_PRECISION_FIXED_POINT) {
+        return "auto";
+    }
+    return precisionName(static_cast<Precision>(precision));
+}
+
+const char* mandel_error(const mandel_context* context) {
+    return context->error.c_str();
+}
+
+void mandel_colorize(const int* iterations, int count, int max_iterations, int palette, uint32_t* argb) {
+    for (int i = 0; i < count; ++i) {
+        int n = iterations[i];
+        if (palette == MANDEL_PALETTE_GRAYSCALE) {
+            uint32_t level = static_cast<uint32_t>(static_cast<long long>(n) * 255 / max_iterations);
+            argb[i] = 0xFF000000u | (level << 16) | (level << 8) | level;
+        } else if (n == max_iterations) {
+            // Point is in the set - black
+            argb[i] = 0xFF000000u;
+        } else {
+            // Point is not in the set - colorful
+            uint32_t r = (n * 9) % 256;
+            uint32_t g = (n * 15) % 256;
+            uint32_t b = (n * 12) % 256;
+            argb[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+        }
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,99 @@
+#ifndef MANDEL_H
+#define MANDEL_H
+
+/*
+ * libmandel: the fractal core shared by the C and C++ viewers, behind a
+ * plain C API. Fill in a mandel_request, and mandel_render() writes one
+ * iteration count per pixel; mandel_colorize() turns those into ARGB8888.
+ *
+ * Rendering uses the optimized C++ kernels (specialized per formula, SIMD
+ * lanes, precision ladder) on a pool of worker threads owned by the
+ * context. A context renders one request at a time; use one context per
+ * thread that renders.
+ */
+
+#include <stdint.h>
+
+/* Library version. Bump it when kernels change: saved tuning results
+ * (autotune.hpp) are only reused by the version that measured them. */
+#define MANDEL_VERSION "1.1.0"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* MANDEL_VERSION of the library actually linked */
+const char* mandel_version(void);
+
+/* Fractal formulas */
+enum {
+    MANDEL_MULTIBROT = 0,
+    MANDEL_BURNING_SHIP = 1,
+    MANDEL_TRICORN = 2
+};
+
+/* Arithmetic. AUTO picks the cheapest that resolves the view's pixels. */
+enum {
+    MANDEL_PRECISION_AUTO = -1,
+    MANDEL_PRECISION_FLOAT = 0,
+    MANDEL_PRECISION_DOUBLE = 1,
+    MANDEL_PRECISION_DOUBLE_DOUBLE = 2,
+    MANDEL_PRECISION_PERTURBATION = 3,
+    MANDEL_PRECISION_FIXED_POINT = 4
+};
+
+/* Palettes for mandel_colorize() */
+enum {
+    MANDEL_PALETTE_GRAYSCALE = 0, /* the C viewer's */
+    MANDEL_PALETTE_BANDS = 1      /* the C++ viewer's */
+};
+
+/* What to render. mandel_request_init() fills in the full Mandelbrot set. */
+typedef struct mandel_request {
+    int width;
+    int height;
+    double center_real;
+    double center_imag;
+    double center_real_lo; /* low parts of a double-double center, or 0 */
+    double center_imag_lo;
+    double pixel_size;     /* distance between neighbouring pixels */
+    int max_iterations;
+    int formula;           /* MANDEL_MULTIBROT, ... */
+    int power;             /* Multibrot power, 2 to 8 */
+    int julia;             /* nonzero for the Julia set of julia_real + i julia_imag */
+    double julia_real;
+    double julia_imag;
+    int precision;         /* MANDEL_PRECISION_AUTO, ... */
+} mandel_request;
+
+typedef struct mandel_context mandel_context;
+
+void mandel_request_init(mandel_request* request, int width, int height);
+
+/* threads = 0 starts one worker per hardware thread. NULL on failure. */
+mandel_context* mandel_create(int threads);
+void mandel_destroy(mandel_context* context);
+int mandel_thread_count(const mandel_context* context);
+
+/*
+ * Render request into iterations (width * height ints, row-major). Pixels
+ * in the set get max_iterations. Returns 0 on success, or -1 with the
+ * reason in mandel_error().
+ */
+int mandel_render(mandel_context* context, const mandel_request* request, int* iterations);
+
+/* Precision the last successful mandel_render() used, e.g. for AUTO */
+int mandel_last_precision(const mandel_context* context);
+const char* mandel_precision_name(int precision);
+
+/* Message for the last failed call on this context */
+const char* mandel_error(const mandel_context* context);
+
+/* Map count iteration counts to ARGB8888 pixels */
+void mandel_colorize(const int* iterations, int count, int max_iterations, int palette, uint32_t* argb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
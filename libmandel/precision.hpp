@@ -0,0 +1,274 @@
+#ifndef PRECISION_HPP
+#define PRECISION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "double_double.hpp"
+#include "fixed_point.hpp"
+#include "fractal.hpp"
+
+// Precision ladder.
+//
+// Each frame is rendered with the cheapest arithmetic that can still tell
+// neighbouring pixels apart: float for shallow views (twice the SIMD lanes),
+// then double. Past the reach of double, perturbation around a double-double
+// reference orbit is used; formulas without a perturbation recurrence fall
+// back to iterating every pixel in double-double, which is much slower.
+//
+// Fixed point is not a rung of the ladder: it is selected explicitly when
+// renders must be bit-identical across hosts (see chooseDeterministic()).
+
+enum class Precision {
+    Float,
+    Double,
+    DoubleDouble,
+    Perturbation,
+    FixedPoint
+};
+
+const int PRECISION_COUNT = 5;
+
+inline const char* precisionName(Precision precision) {
+    switch (precision) {
+        case Precision::Float: return "float";
+        case Precision::Double: return "double";
+        case Precision::DoubleDouble: return "double-double";
+        case Precision::Perturbation: return "perturbation";
+        default: return "fixed-point";
+    }
+}
+
+// Smallest pixel spacing, relative to the coordinate magnitude, that float
+// and double still resolve. Rounding is amplified along long boundary
+// orbits, so both keep a wide margin of guard bits (14 for float, 20 for
+// double). The default full-set view stays on float.
+const double FLOAT_MIN_SPACING = 1.0 / (1 << 10);         // 2^-10, float has 24 bits
+const double DOUBLE_MIN_SPACING = 1.0 / 8589934592.0;     // 2^-33, double has 53 bits
+
+// Deepest pixel spacing the double-double viewport center can address
+const double MIN_PIXEL_SPACING = 1e-28;
+
+// Perturbation only has a delta recurrence for z^2 + c in Mandelbrot mode
+inline bool supportsPerturbation(const FractalParams& params) {
+    return params.formula == FormulaKind::Multibrot && params.power == 2 && !params.julia;
+}
+
+// Function to pick the cheapest precision that resolves the view's pixels
+inline Precision choosePrecision(const Viewport& view, const FractalParams& params) {
+    // Largest coordinate magnitude anywhere in the view
+    double magnitude = std::max(std::fabs(view.centerReal) + view.pixelSize * view.width * 0.5,
+                                std::fabs(view.centerImag) + view.pixelSize * view.height * 0.5);
+    double spacing = view.pixelSize / magnitude;
+
+    if (spacing >= FLOAT_MIN_SPACING) {
+        return Precision::Float;
+    }
+    if (spacing >= DOUBLE_MIN_SPACING) {
+        return Precision::Double;
+    }
+    return supportsPerturbation(params) ? Precision::Perturbation : Precision::DoubleDouble;
+}
+
+// Function to pick fixed point when it can render the view, so the result is
+// the same on every host; otherwise fall back to the regular ladder
+inline Precision chooseDeterministic(const Viewport& view, const FractalParams& params) {
+    if (supportsFixedPoint(params) && view.pixelSize >= FIXED_MIN_PIXEL_SIZE) {
+        return Precision::FixedPoint;
+    }
+    return choosePrecision(view, params);
+}
+
+// The next more precise rung, used to validate a choice. Perturbation,
+// fixed point and double-double are checked against direct double-double
+// iteration.
+inline Precision nextPrecision(Precision precision, const FractalParams& params) {
+    switch (precision) {
+        case Precision::Float: return Precision::Double;
+        case Precision::Double:
+            return supportsPerturbation(params) ? Precision::Perturbation : Precision::DoubleDouble;
+        default:
+            return Precision::DoubleDouble;
+    }
+}
+
+// Orbit of the view center, iterated in double-double and stored rounded
+// to double. Z[0] = 0 and Z[1] = C so pixels can rebase onto the start.
+struct ReferenceOrbit {
+    std::vector<double> real;
+    std::vector<double> imag;
+
+    void compute(const Viewport& view, int maxIterations) {
+        DoubleDouble cr(view.centerReal, view.centerRealLo);
+        DoubleDouble ci(view.centerImag, view.centerImagLo);
+        DoubleDouble zr;
+        DoubleDouble zi;
+
+        real.assign(1, 0.0);
+        imag.assign(1, 0.0);
+        for (int n = 0; n <= maxIterations; ++n) {
+            Multibrot<2>::step(zr, zi, cr, ci);
+            real.push_back(zr.toDouble());
+            imag.push_back(zi.toDouble());
+            if (zr * zr + zi * zi > DoubleDouble(4.0)) {
+                break;
+            }
+        }
+    }
+};
+
+// Render a rectangle by perturbation: each pixel iterates only its offset
+// dz from the reference orbit in double precision,
+//     dz' = (2 Z + dz) dz + dc
+// and rebases onto the start of the reference when |Z + dz| < |dz| or the
+// reference runs out, which avoids the classic glitch detection.
+inline void renderRectPerturbed(const Viewport& view, const ReferenceOrbit& reference,
+                                int x0, int y0, int x1, int y1, int maxIterations,
+                                int* out, int outStride, LaneStats* stats) {
+    const double* refReal = reference.real.data();
+    const double* refImag = reference.imag.data();
+    const int last = static_cast<int>(reference.real.size()) - 1;
+    long long useful = 0;
+
+    for (int y = y0; y < y1; ++y) {
+        const double dci = (y - view.height * 0.5) * view.pixelSize;
+        for (int x = x0; x < x1; ++x) {
+            const double dcr = (x - view.width * 0.5) * view.pixelSize;
+            double dzr = dcr;
+            double dzi = dci;
+            int m = 1;
+            int n = 0;
+
+            while (n < maxIterations) {
+                double zr = refReal[m] + dzr;
+                double zi = refImag[m] + dzi;
+                double magnitude = zr * zr + zi * zi;
+                if (magnitude > 4.0) {
+                    break;
+                }
+                if (magnitude < dzr * dzr + dzi * dzi || m == last) {
+                    dzr = zr;
+                    dzi = zi;
+                    m = 0;
+                }
+                double tr = 2.0 * refReal[m] + dzr;
+                double ti = 2.0 * refImag[m] + dzi;
+                double newReal = tr * dzr - ti * dzi + dcr;
+                double newImag = tr * dzi + ti * dzr + dci;
+                dzr = newReal;
+                dzi = newImag;
+                m++;
+                n++;
+            }
+
+            out[(y - y0) * outStride + (x - x0)] = n;
+            useful += n;
+        }
+    }
+
+    if (stats) {
+        stats->usefulIterations += useful;
+        stats->laneSlots += useful;
+    }
+}
+
+// Everything needed to render one frame at one precision: the resolved
+// kernel and, for perturbation, the shared reference orbit. Prepared once
+// per frame, then renderRect() can be called for any part of the frame.
+class FrameKernel {
+private:
+    Viewport view;
+    FractalParams params;
+    int maxIterations;
+    Precision precision;
+    RectKernel kernel;
+    ReferenceOrbit reference;
+
+public:
+    FrameKernel()
+        : view(1, 1), maxIterations(0), precision(Precision::Double), kernel(nullptr) {}
+
+    // Float and double use the given lane layout; the wider types always
+    // refill their lanes
+    void prepare(const Viewport& viewport, const FractalParams& fractal,
+                 int iterations, Precision chosen, LaneLayout layout = LaneLayout::Refill) {
+        view = viewport;
+        params = fractal;
+        maxIterations = iterations;
+        precision = chosen;
+        if (precision == Precision::Perturbation && !supportsPerturbation(params)) {
+            precision = Precision::DoubleDouble;
+        }
+        if (precision == Precision::FixedPoint && !supportsFixedPoint(params)) {
+            precision = Precision::DoubleDouble;
+        }
+
+        switch (precision) {
+            case Precision::Float: kernel = selectRectKernel<float>(params, layout); break;
+            case Precision::Double: kernel = selectRectKernel<double>(params, layout); break;
+            case Precision::DoubleDouble: kernel = selectRectKernel<DoubleDouble>(params); break;
+            case Precision::FixedPoint: kernel = selectRectKernel<Fixed>(params); break;
+            default:
+                kernel = nullptr;
+                reference.compute(view, maxIterations);
+                break;
+        }
+    }
+
+    Precision getPrecision() const { return precision; }
+    const Viewport& getViewport() const { return view; }
+    int getMaxIterations() const { return maxIterations; }
+
+    void renderRect(int x0, int y0, int x1, int y1, int* out, int outStride, LaneStats* stats) const {
+        if (kernel) {
+            kernel(view, params, x0, y0, x1, y1, maxIterations, out, outStride, stats);
+        } else {
+            renderRectPerturbed(view, reference, x0, y0, x1, y1, maxIterations, out, outStride, stats);
+        }
+    }
+};
+
+// A pixel is visibly different when its iteration count moves by more than
+// a few iterations and by more than a tenth; isolated chaotic pixels on the
+// boundary differ between any two precisions and are not a visible change.
+// The view is flagged once that share of pixels exceeds the tolerance.
+const int VALIDATION_MIN_DIFFERENCE = 2;
+const double VALIDATION_TOLERANCE = 0.005;
+
+struct ValidationResult {
+    Precision selected;
+    Precision reference;
+    double mismatchedFraction;
+    bool visiblyDifferent;
+};
+
+// Function to render the view at its selected precision and at the next
+// rung up, and report how many pixels disagree
+inline ValidationResult validatePrecision(const Viewport& view, const FractalParams& params,
+                                          int maxIterations, Precision selected) {
+    ValidationResult result;
+    result.selected = selected;
+    result.reference = nextPrecision(selected, params);
+
+    std::vector<int> lower(static_cast<size_t>(view.width) * view.height);
+    std::vector<int> upper(lower.size());
+    FrameKernel kernel;
+    kernel.prepare(view, params, maxIterations, result.selected);
+    kernel.renderRect(0, 0, view.width, view.height, lower.data(), view.width, nullptr);
+    kernel.prepare(view, params, maxIterations, result.reference);
+    kernel.renderRect(0, 0, view.width, view.height, upper.data(), view.width, nullptr);
+
+    size_t mismatched = 0;
+    for (size_t i = 0; i < lower.size(); ++i) {
+        int difference = std::abs(lower[i] - upper[i]);
+        mismatched += difference > VALIDATION_MIN_DIFFERENCE &&
+                      difference * 10 > std::max(lower[i], upper[i]);
+    }
+    result.mismatchedFraction = static_cast<double>(mismatched) / lower.size();
+    result.visiblyDifferent = result.mismatchedFraction > VALIDATION_TOLERANCE;
+    return result;
+}
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef RENDER_FARM_HPP
+#define RENDER_FARM_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RENDER_FARM_SUPPORTED 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#else
+#define RENDER_FARM_SUPPORTED 0
+#endif
+
+#include "fractal.hpp"
+#include "precision.hpp"
+#include "tile_scheduler.hpp"
+
+// Multi-process renderer for frames too large to want in one process
+// (posters, video frames).
+//
+// The coordinator maps a shared framebuffer (memfd_create on Linux,
+// shm_open elsewhere), prepares the frame's kernel and forks worker
+// processes, which inherit both. Each worker has a Unix-domain socket to
+// the coordinator, over which it is sent tile rectangles and answers with
+// the tile's index once it has rendered the tile straight into the shared
+// framebuffer; no pixels ever travel through a socket. Every worker keeps
+// FARM_PIPELINE tiles queued so it never waits for its next one.
+//
+// A worker that dies, crashes or closes its socket is noticed at once as
+// end-of-file on its socket. The tiles it held go back to the front of the
+// queue and a new worker is forked in its place, up to maxRespawns times;
+// a tile is only done once its worker has answered, so a partly written
+// tile is always rendered again. The frame fails only if every worker is
+// gone and none can be replaced.
+//
+// Workers are forked from the calling process, so start a farm before the
+// process has threads of its own (the viewer runs it instead of its UI).
+
+// Tiles each worker holds at once: one rendering, the rest waiting
+const int FARM_PIPELINE = 2;
+
+struct FarmSettings {
+    int workers;     // 0: one per hardware thread
+    int maxRespawns; // replacement workers forked over the whole frame
+    // Testing: the first worker exits abruptly after rendering this many
+    // tiles (its replacements do not), or -1
+    int crashAfterTiles;
+
+    FarmSettings() : workers(0), maxRespawns(8), crashAfterTiles(-1) {}
+};
+
+struct FarmStats {
+    int tiles;
+    int workers;
+    int crashes;    // workers lost during the frame
+    int reassigned; // tiles handed to another worker after a crash
+    double seconds;
+
+    FarmStats() : tiles(0), workers(0), crashes(0), reassigned(0), seconds(0.0) {}
+};
+
+// Messages on a worker's socket, fixed-size so a read is one message
+struct FarmTileMessage {
+    int32_t index; // tile index, or -1: exit
+    int32_t x0, y0, x1, y1;
+};
+
+struct FarmDoneMessage {
+    int32_t index;
+};
+
+class RenderFarm {
+private:
+    struct Worker {
+        int pid;
+        int socket;
+        std::vector<int> held; // tile indices sent and not yet answered
+    };
+
+    FarmSettings settings;
+    std::string failure;
+    FarmStats lastStats;
+
+    int* framebuffer;
+    size_t framebufferBytes;
+
+#if RENDER_FARM_SUPPORTED
+    // Function to create the shared framebuffer, or return -1
+    static int createSharedMemory(size_t bytes) {
+        int fd = -1;
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        fd = memfd_create("mandel_farm", MFD_CLOEXEC);
+#endif
+        if (fd < 0) {
+            // Unlinked at once; the descriptor keeps the memory alive
+            std::string name = "/mandel_farm_" + std::to_string(getpid());
+            fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd >= 0) {
+                shm_unlink(name.c_str());
+            }
+        }
+        if (fd >= 0 && ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        return fd;
+    }
+
+    static bool writeAll(int fd, const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+#ifdef MSG_NOSIGNAL
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+#else
+            ssize_t sent = send(fd, bytes, size, 0);
+#endif
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    // Function to read one whole message; false on end-of-file or error
+    static bool readAll(int fd, void* data, size_t size) {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t got = read(fd, bytes, size);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                return false;
+            }
+            bytes += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    // Function run by a worker process until its socket closes; never returns
+    [[noreturn]] static void workerMain(int socket, const FrameKernel& kernel, int* frame, int width,
+                                        int crashAfterTiles) {
+        int rendered = 0;
+        FarmTileMessage tile;
+        while (readAll(socket, &tile, sizeof(tile)) && tile.index >= 0) {
+            if (rendered == crashAfterTiles) {
+                _exit(3);
+            }
+            kernel.renderRect(tile.x0, tile.y0, tile.x1, tile.y1,
+                              &frame[static_cast<size_t>(tile.y0) * width + tile.x0], width, nullptr);
+            rendered++;
+            FarmDoneMessage done = { tile.index };
+            if (!writeAll(socket, &done, sizeof(done))) {
+                break;
+            }
+        }
+        _exit(0);
+    }
+
+    // Function to fork one worker; false if the socket or process could not
+    // be created
+    bool spawn(std::vector<Worker>& workers, const FrameKernel& kernel, int width, int crashAfterTiles) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            failure = std::string("socketpair: ") + std::strerror(errno);
+            return false;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            failure = std::string("fork: ") + std::strerror(errno);
+            close(sockets[0]);
+            close(sockets[1]);
+            return false;
+        }
+        if (pid == 0) {
+            // The other workers' sockets belong to the coordinator
+            for (size_t w = 0; w < workers.size(); ++w) {
+                close(workers[w].socket);
+            }
+            close(sockets[0]);
+            workerMain(sockets[1], kernel, framebuffer, width, crashAfterTiles);
+        }
+        close(sockets[1]);
+        Worker worker;
+        worker.pid = static_cast<int>(pid);
+        worker.socket = sockets[0];
+        workers.push_back(worker);
+        return true;
+    }
+
+    // Function to hand a worker tiles from the queue until it holds
+    // FARM_PIPELINE; false if its socket is gone
+    static bool feed(Worker& worker, std::deque<int>& queue, const std::vector<TileTask>& tiles) {
+        while (static_cast<int>(worker.held.size()) < FARM_PIPELINE && !queue.empty()) {
+            int index = queue.front();
+            const TileRect& r = tiles[index].rect;
+            FarmTileMessage message = { index, r.x0, r.y0, r.x1, r.y1 };
+            if (!writeAll(worker.socket, &message, sizeof(message))) {
+                return false;
+            }
+            queue.pop_front();
+            worker.held.push_back(index);
+        }
+        return true;
+    }
+
+    // Function to stop a worker: tell it to exit (or, if it crashed, just
+    // close its socket) and reap it
+    static void retire(Worker& worker) {
+        FarmTileMessage quit = { -1, 0, 0, 0, 0 };
+        writeAll(worker.socket, &quit, sizeof(quit));
+        close(worker.socket);
+        int status;
+        while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+#endif
+
+    void releaseFramebuffer() {
+#if RENDER_FARM_SUPPORTED
+        if (framebuffer != nullptr) {
+            munmap(framebuffer, framebufferBytes);
+        }
+#endif
+        framebuffer = nullptr;
+        framebufferBytes = 0;
+    }
+
+public:
+    RenderFarm(const FarmSettings& farmSettings = FarmSettings())
+        : settings(farmSettings), framebuffer(nullptr), framebufferBytes(0) {}
+
+    ~RenderFarm() { releaseFramebuffer(); }
+
+    RenderFarm(const RenderFarm&) = delete;
+    RenderFarm& operator=(const RenderFarm&) = delete;
+
+    // Function to render a frame on the worker processes. Returns false and
+    // sets error() if the frame could not be finished.
+    bool render(const Viewport& view, const FractalParams& params, int maxIterations, Precision precision) {
+        failure.clear();
+        lastStats = FarmStats();
+        releaseFramebuffer();
+#if RENDER_FARM_SUPPORTED
+        auto start = std::chrono::steady_clock::now();
+        framebufferBytes = static_cast<size_t>(view.width) * view.height * sizeof(int);
+        int memory = createSharedMemory(framebufferBytes);
+        if (memory < 0) {
+            failure = std::string("shared memory: ") + std::strerror(errno);
+            return false;
+        }
+        void* mapping = mmap(nullptr, framebufferBytes, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+        close(memory);
+        if (mapping == MAP_FAILED) {
+            failure = std::string("mmap: ") + std::strerror(errno);
+            framebufferBytes = 0;
+            return false;
+        }
+        framebuffer = static_cast<int*>(mapping);
+
+        // The workers inherit the prepared kernel (and any reference orbit)
+        FrameKernel kernel;
+        kernel.prepare(view, params, maxIterations, precision);
+        std::vector<TileTask> tiles = makeTiles(view.width, view.height, 0);
+        std::deque<int> queue;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            queue.push_back(static_cast<int>(i));
+        }
+
+        int count = settings.workers > 0 ? settings.workers
+                                         : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        count = std::min(count, static_cast<int>(tiles.size()));
+        std::vector<Worker> workers;
+        for (int w = 0; w < count; ++w) {
+            if (!spawn(workers, kernel, view.width, w == 0 ? settings.crashAfterTiles : -1)) {
+                break;
+            }
+        }
+        lastStats.workers = static_cast<int>(workers.size());
+
+        int remaining = static_cast<int>(tiles.size());
+        int respawns = 0;
+        std::vector<pollfd> polls;
+        while (remaining > 0 && !workers.empty()) {
+            // Hand out tiles; a worker that cannot take them is dealt with
+            // below, once its socket reports the hang-up
+            polls.clear();
+            for (size_t w = 0; w < workers.size(); ++w) {
+                feed(workers[w], queue, tiles);
+                pollfd entry = { workers[w].socket, POLLIN, 0 };
+                polls.push_back(entry);
+            }
+            if (poll(polls.data(), polls.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                failure = std::string("poll: ") + std::strerror(errno);
+                break;
+            }
+
+            for (size_t w = workers.size(); w-- > 0;) {
+                if (polls[w].revents == 0) {
+                    continue;
+                }
+                Worker& worker = workers[w];
+                FarmDoneMessage done;
+                if ((polls[w].revents & POLLIN) && readAll(worker.socket, &done, sizeof(done))) {
+                    std::vector<int>::iterator held = std::find(worker.held.begin(), worker.held.end(), done.index);
+                    if (held != worker.held.end()) {
+                        worker.held.erase(held);
+                        remaining--;
+                    }
+                    continue;
+                }
+
+                // Lost: its unfinished tiles are rendered again, first
+                lastStats.crashes++;
+                lastStats.reassigned += static_cast<int>(worker.held.size());
+                for (size_t i = worker.held.size(); i-- > 0;) {
+                    queue.push_front(worker.held[i]);
+                }
+                worker.held.clear();
+                retire(worker);
+                workers.erase(workers.begin() + static_cast<std::ptrdiff_t>(w));
+                if (respawns < settings.maxRespawns && spawn(workers, kernel, view.width, -1)) {
+                    respawns++;
+                    lastStats.workers++;
+                }
+            }
+        }
+
+        for (size_t w = 0; w < workers.size(); ++w) {
+            retire(workers[w]);
+        }
+        lastStats.tiles = static_cast<int>(tiles.size());
+        lastStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (remaining > 0) {
+            if (failure.empty()) {
+                failure = "every worker process was lost";
+            }
+            return false;
+        }
+        return true;
+#else
+        (void)view;
+        (void)params;
+        (void)maxIterations;
+        (void)precision;
+        failure = "the render farm needs fork and Unix-domain sockets";
+        return false;
+#endif
+    }
+
+    // The frame's iteration counts, in the shared framebuffer; valid after a
+    // successful render() until the next one
+    const int* iterations() const { return framebuffer; }
+
+    const FarmStats& stats() const { return lastStats; }
+
+    const std::string& error() const { return failure; }
+};
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef TILE_CACHE_HPP
+#define TILE_CACHE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "fractal.hpp"
+#include "precision.hpp"
+
+// Cache of rendered tiles, filled by finished frames and by speculation.
+//
+// Tiles are grouped by the frame view they were cut from; a group's tile
+// grid extends past its screen in every direction, so speculation can add
+// off-screen neighbours to it. A later frame can take pixels from a group
+// when it renders the same fractal on the same pixel lattice: the same
+// pixel size and a whole number of pixels between the two centers. Pans
+// (centerOn) keep the lattice, and zooming in 2x at any pixel lands on the
+// same refined lattice, so one speculative group serves every cursor
+// position.
+
+const int TILE_SIZE = 64;
+
+// Screen rectangle [x0, x1) x [y0, y1)
+struct TileRect {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Tiles and groups kept before the least recently used group is dropped.
+// Each tile is 16 KB; every lookup scans the groups.
+const size_t TILE_CACHE_CAPACITY = 1024;
+const size_t TILE_CACHE_MAX_GROUPS = 64;
+
+// How far from a whole pixel two lattices may be and still match
+const double LATTICE_TOLERANCE = 1e-3;
+
+struct CachedTile {
+    std::vector<int> iterations; // TILE_SIZE x TILE_SIZE
+    bool speculative;
+    bool used;
+};
+
+// Tiles cut from one frame view
+struct CacheGroup {
+    Viewport view;
+    FractalParams params;
+    int maxIterations;
+    Precision precision;
+    FrameKernel kernel; // prepared once, for rendering speculative tiles
+    std::map<std::pair<int, int>, CachedTile> tiles;
+    unsigned long long lastUse;
+
+    CacheGroup(const Viewport& frameView, const FractalParams& fractal, int iterations, Precision chosen)
+        : view(frameView), params(fractal), maxIterations(iterations), precision(chosen), lastUse(0) {
+        kernel.prepare(view, params, maxIterations, precision);
+    }
+
+    bool renders(const FractalParams& fractal, int iterations, Precision chosen) const {
+        return params.formula == fractal.formula && params.power == fractal.power &&
+               params.julia == fractal.julia && params.juliaReal == fractal.juliaReal &&
+               params.juliaImag == fractal.juliaImag && maxIterations == iterations && precision == chosen;
+    }
+};
+
+// Speculation payoff: how many speculative tiles were rendered and how many
+// of them later filled part of a frame
+struct TileCacheStats {
+    long long requestedTiles;
+    long long cachedTiles;
+    long long speculatedTiles;
+    long long speculatedUsed;
+
+    TileCacheStats() : requestedTiles(0), cachedTiles(0), speculatedTiles(0), speculatedUsed(0) {}
+
+    double hitRate() const {
+        return speculatedTiles > 0 ? static_cast<double>(speculatedUsed) / speculatedTiles : 0.0;
+    }
+};
+
+// Floor division, for tile indices left of or above the screen
+inline int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Thread-safe: the UI thread looks tiles up and inserts finished frame
+// tiles, speculation workers insert from their own threads.
+class TileCache {
+private:
+    mutable std::mutex mutex;
+    std::vector<std::shared_ptr<CacheGroup> > groups;
+    TileCacheStats stats;
+    unsigned long long clock;
+
+    void evict() {
+        size_t total = 0;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            total += groups[i]->tiles.size();
+        }
+        while ((total > TILE_CACHE_CAPACITY || groups.size() > TILE_CACHE_MAX_GROUPS) && groups.size() > 1) {
+            size_t oldest = 0;
+            for (size_t i = 1; i < groups.size(); ++i) {
+                if (groups[i]->lastUse < groups[oldest]->lastUse) {
+                    oldest = i;
+                }
+            }
+            total -= groups[oldest]->tiles.size();
+            groups.erase(groups.begin() + oldest);
+        }
+    }
+
+    // Function to find the whole-pixel offset from view to a group's view,
+    // if the two share a pixel lattice
+    static bool latticeOffset(const Viewport& view, const CacheGroup& group, int& dx, int& dy) {
+        if (view.pixelSize != group.view.pixelSize) {
+            return false;
+        }
+        double gx, gy;
+        view.mapTo(group.view, 0.0, 0.0, gx, gy);
+        dx = static_cast<int>(std::floor(gx + 0.5));
+        dy = static_cast<int>(std::floor(gy + 0.5));
+        return std::fabs(gx - dx) < LATTICE_TOLERANCE && std::fabs(gy - dy) < LATTICE_TOLERANCE &&
+               std::fabs(gx) < 1e9 && std::fabs(gy) < 1e9;
+    }
+
+public:
+    TileCache() : clock(0) {}
+
+    // Function to get the group for a frame view, creating it if needed
+    std::shared_ptr<CacheGroup> group(const Viewport& view, const FractalParams& params,
+                                      int maxIterations, Precision precision) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < groups.size(); ++i) {
+            CacheGroup& g = *groups[i];
+            if (g.view.centerReal == view.centerReal && g.view.centerRealLo == view.centerRealLo &&
+                g.view.centerImag == view.centerImag && g.view.centerImagLo == view.centerImagLo &&
+                g.view.pixelSize == view.pixelSize && g.view.width == view.width &&
+                g.view.height == view.height && g.renders(params, maxIterations, precision)) {
+                g.lastUse = ++clock;
+                return groups[i];
+            }
+        }
+        std::shared_ptr<CacheGroup> created = std::make_shared<CacheGroup>(view, params, maxIterations, precision);
+        created->lastUse = ++clock;
+        groups.push_back(created);
+        evict();
+        return created;
+    }
+
+    bool contains(const CacheGroup& group, int tileX, int tileY) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return group.tiles.count(std::make_pair(tileX, tileY)) != 0;
+    }
+
+    // Function to store a full tile of a group, read from a buffer with the
+    // given row stride
+    void insert(CacheGroup& group, int tileX, int tileY, const int* source, int stride, bool speculative) {
+        CachedTile tile;
+        tile.iterations.resize(TILE_SIZE * TILE_SIZE);
+        for (int y = 0; y < TILE_SIZE; ++y) {
+            std::copy(source + y * stride, source + y * stride + TILE_SIZE, &tile.iterations[y * TILE_SIZE]);
+        }
+        tile.speculative = speculative;
+        tile.used = false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!group.tiles.insert(std::make_pair(std::make_pair(tileX, tileY), tile)).second) {
+            return;
+        }
+        group.lastUse = ++clock;
+        stats.speculatedTiles += speculative;
+        evict();
+    }
+
+    // Function to fill a rectangle of a frame from any group on the same
+    // lattice that has every pixel of it. Returns false on a miss. On a hit,
+    // *speculated (if given) tells whether any of it was rendered speculatively.
+    bool lookup(const Viewport& view, const FractalParams& params, int maxIterations, Precision precision,
+                const TileRect& rect, int* out, int outStride, bool* speculated = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.requestedTiles++;
+        for (size_t i = groups.size(); i-- > 0;) {
+            CacheGroup& g = *groups[i];
+            int dx, dy;
+            if (!g.renders(params, maxIterations, precision) || !latticeOffset(view, g, dx, dy)) {
+                continue;
+            }
+
+            // Tiles of the group the rectangle overlaps
+            int tx0 = floorDiv(rect.x0 + dx, TILE_SIZE);
+            int ty0 = floorDiv(rect.y0 + dy, TILE_SIZE);
+            int tx1 = floorDiv(rect.x1 - 1 + dx, TILE_SIZE);
+            int ty1 = floorDiv(rect.y1 - 1 + dy, TILE_SIZE);
+            bool covered = true;
+            for (int ty = ty0; ty <= ty1 && covered; ++ty) {
+                for (int tx = tx0; tx <= tx1 && covered; ++tx) {
+                    covered = g.tiles.count(std::make_pair(tx, ty)) != 0;
+                }
+            }
+            if (!covered) {
+                continue;
+            }
+            if (speculated != nullptr) {
+                *speculated = false;
+            }
+
+            for (int y = rect.y0; y < rect.y1; ++y) {
+                int gy = y + dy;
+                int ty = floorDiv(gy, TILE_SIZE);
+                for (int x = rect.x0; x < rect.x1;) {
+                    int gx = x + dx;
+                    int tx = floorDiv(gx, TILE_SIZE);
+                    CachedTile& tile = g.tiles[std::make_pair(tx, ty)];
+                    int run = std::min(rect.x1 - x, (tx + 1) * TILE_SIZE - gx);
+                    const int* source = &tile.iterations[(gy - ty * TILE_SIZE) * TILE_SIZE + gx - tx * TILE_SIZE];
+                    std::copy(source, source + run, out + (y - rect.y0) * outStride + (x - rect.x0));
+                    if (speculated != nullptr && tile.speculative) {
+                        *speculated = true;
+                    }
+                    if (tile.speculative && !tile.used) {
+                        tile.used = true;
+                        stats.speculatedUsed++;
+                    }
+                    x += run;
+                }
+            }
+            g.lastUse = ++clock;
+            stats.cachedTiles++;
+            return true;
+        }
+        return false;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        groups.clear();
+    }
+
+    TileCacheStats getStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
+
+#endif
@@ -0,0 +1,710 @@
+#ifndef TILE_SCHEDULER_HPP
+#define TILE_SCHEDULER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "fractal.hpp"
+#include "precision.hpp"
+#include "tile_cache.hpp"
+#include "trace.hpp"
+
+// Parallel tile renderer.
+//
+// A frame is cut into TILE_SIZE squares. Worker threads claim tiles with an
+// atomic counter and render them into the frame's staging buffer; each
+// finished tile is pushed onto a lock-free multi-producer/single-consumer
+// queue that the UI thread drains once per loop iteration. Neither claiming
+// nor completing a tile takes a lock.
+//
+// There are two frame slots (double-buffered staging). Starting a frame
+// cancels the one in flight, waits for the at most one tile per worker that
+// is still running, and renders into the other slot, so the previous
+// frame's iterations stay readable while the new one fills in.
+//
+// Tiles on the set boundary can cost a hundred times more than smooth
+// exterior tiles, and the frame is only done when its slowest tile is. With
+// TileOrder::LongestFirst the measured cost of every tile of the previous
+// frame is reprojected through the pan/zoom onto the new tiles, and workers
+// claim the most expensive tiles first (LPT ordering).
+//
+// With TileOrder::Focus workers instead claim the unclaimed tile nearest to
+// a focus point (the cursor), read afresh at every claim, so moving the
+// cursor re-prioritizes the rest of the frame immediately. A running tile
+// is never interrupted; the focus takes effect at the next tile boundary.
+//
+// With a TileCache attached, frame tiles the cache already holds are copied
+// in at submit and never reach the workers, and finished tiles are added to
+// it. Once every tile of the current frame has been claimed, a second set
+// of idle-priority threads renders speculative tiles into the cache (where
+// the user is likely to pan or zoom next). They check for a new frame every
+// few rows and drop their tile as soon as one arrives.
+//
+// The UI thread does not need to poll: an optional wake callback is called
+// by the worker whose tile makes the completion queue non-empty for the
+// consumer, at most once per drain (see setWakeCallback()).
+//
+// With tracing enabled (see trace.hpp) every tile, claim scan, cancellation
+// and speculative tile is recorded on the thread that did it.
+
+// Rows a speculative tile renders between checks for foreground work
+const int SPECULATIVE_STRIP_ROWS = 8;
+
+// Lane slots charged per pixel on top of its iterations, for setup and store
+const double TILE_PIXEL_OVERHEAD = 8.0;
+
+// Order in which workers claim the tiles of a frame
+enum class TileOrder {
+    Fifo,         // row-major
+    LongestFirst, // predicted most expensive first
+    Focus         // nearest to the focus point first
+};
+
+struct TileTask;
+
+// Link of the completion queue, embedded in every tile
+struct CompletionNode {
+    std::atomic<CompletionNode*> next;
+    TileTask* task;
+
+    CompletionNode() : next(nullptr), task(nullptr) {}
+    CompletionNode(const CompletionNode&) : next(nullptr), task(nullptr) {}
+    CompletionNode& operator=(const CompletionNode&) {
+        next.store(nullptr);
+        task = nullptr;
+        return *this;
+    }
+};
+
+// Vyukov's intrusive MPSC queue: producers swap themselves in as the head
+// with a single atomic exchange; the one consumer walks from the tail.
+class CompletionQueue {
+private:
+    std::atomic<CompletionNode*> head;
+    CompletionNode* tail;
+    CompletionNode stub;
+
+public:
+    CompletionQueue() : head(&stub), tail(&stub) {}
+
+    // Any thread
+    void push(CompletionNode* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        CompletionNode* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer thread only. Returns nullptr when the queue is empty, or when
+    // a producer is between its exchange and its link (it shows up next time).
+    CompletionNode* pop() {
+        CompletionNode* first = tail;
+        CompletionNode* next = first->next.load(std::memory_order_acquire);
+        if (first == &stub) {
+            if (next == nullptr) {
+                return nullptr;
+            }
+            tail = next;
+            first = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            tail = next;
+            return first;
+        }
+        if (first != head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        // first is the last node: put the stub behind it so it can be taken
+        push(&stub);
+        next = first->next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            tail = next;
+            return first;
+        }
+        return nullptr;
+    }
+};
+
+// One tile of a frame and its result
+struct TileTask {
+    CompletionNode node;
+    TileRect rect;
+    int generation;
+    double predictedCost;
+    bool done;
+    bool cached;     // copied from the tile cache rather than rendered
+    bool speculated; // cached, and speculation rendered (some of) it
+    int worker;      // index of the worker thread that rendered it, or -1
+    double seconds;
+    LaneStats stats;
+
+    TileTask()
+        : generation(-1), predictedCost(0.0), done(false), cached(false), speculated(false), worker(-1),
+          seconds(0.0) {}
+
+    int area() const { return (rect.x1 - rect.x0) * (rect.y1 - rect.y0); }
+
+    // Work the tile actually took, in lane slots
+    double measuredCost() const {
+        return static_cast<double>(stats.laneSlots) + TILE_PIXEL_OVERHEAD * area();
+    }
+};
+
+// Function to cut a width x height frame into row-major tiles
+inline std::vector<TileTask> makeTiles(int width, int height, int generation) {
+    std::vector<TileTask> tiles;
+    for (int y = 0; y < height; y += TILE_SIZE) {
+        for (int x = 0; x < width; x += TILE_SIZE) {
+            TileTask task;
+            task.rect.x0 = x;
+            task.rect.y0 = y;
+            task.rect.x1 = std::min(x + TILE_SIZE, width);
+            task.rect.y1 = std::min(y + TILE_SIZE, height);
+            task.generation = generation;
+            tiles.push_back(task);
+        }
+    }
+    return tiles;
+}
+
+// Function to get the row-major index of a tile of a frame width pixels wide
+inline int tileId(const TileRect& r, int width) {
+    return r.y0 / TILE_SIZE * ((width + TILE_SIZE - 1) / TILE_SIZE) + r.x0 / TILE_SIZE;
+}
+
+// Per-pixel cost of the tiles of a finished frame, used to predict the cost
+// of the tiles of the next frame after a pan or zoom
+class TileCostMap {
+private:
+    Viewport view;
+    int tilesX;
+    int tilesY;
+    std::vector<double> costPerPixel; // negative where the tile never finished
+    double meanCostPerPixel;
+    bool valid;
+
+public:
+    TileCostMap() : view(1, 1), tilesX(0), tilesY(0), meanCostPerPixel(0.0), valid(false) {}
+
+    bool isValid() const { return valid; }
+
+    // Function to forget the recorded costs, when they describe another fractal
+    void clear() { valid = false; }
+
+    // Function to record the measured costs of a frame's tiles, in any order
+    void record(const Viewport& frameView, const std::vector<TileTask>& tiles) {
+        view = frameView;
+        tilesX = (view.width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (view.height + TILE_SIZE - 1) / TILE_SIZE;
+        costPerPixel.assign(tilesX * tilesY, -1.0);
+
+        double total = 0.0;
+        long long pixels = 0;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            const TileTask& task = tiles[i];
+            if (!task.done || task.cached) {
+                continue;
+            }
+            int index = (task.rect.y0 / TILE_SIZE) * tilesX + task.rect.x0 / TILE_SIZE;
+            costPerPixel[index] = task.measuredCost() / task.area();
+            total += task.measuredCost();
+            pixels += task.area();
+        }
+        valid = pixels > 0;
+        meanCostPerPixel = valid ? total / pixels : 0.0;
+    }
+
+    // Function to estimate a tile of newView by sampling a 4x4 grid of its
+    // pixels, mapping each into this frame and reading the cost of the tile
+    // it lands in. Samples that fall outside this frame use the mean.
+    double predict(const Viewport& newView, const TileRect& rect) const {
+        const int samples = 4;
+        double sum = 0.0;
+        for (int sy = 0; sy < samples; ++sy) {
+            for (int sx = 0; sx < samples; ++sx) {
+                double px = rect.x0 + (rect.x1 - rect.x0) * (sx + 0.5) / samples;
+                double py = rect.y0 + (rect.y1 - rect.y0) * (sy + 0.5) / samples;
+                double ox, oy;
+                newView.mapTo(view, px, py, ox, oy);
+
+                double cost = meanCostPerPixel;
+                if (ox >= 0.0 && oy >= 0.0 && ox < view.width && oy < view.height) {
+                    int index = static_cast<int>(oy) / TILE_SIZE * tilesX + static_cast<int>(ox) / TILE_SIZE;
+                    if (costPerPixel[index] >= 0.0) {
+                        cost = costPerPixel[index];
+                    }
+                }
+                sum += cost;
+            }
+        }
+        return sum / (samples * samples) * (rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+    }
+};
+
+// Function to order tiles for claiming: most expensive predicted cost first
+inline void orderLongestFirst(std::vector<TileTask>& tiles, const TileCostMap& costs, const Viewport& view) {
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        tiles[i].predictedCost = costs.predict(view, tiles[i].rect);
+    }
+    std::stable_sort(tiles.begin(), tiles.end(), [](const TileTask& a, const TileTask& b) {
+        return a.predictedCost > b.predictedCost;
+    });
+}
+
+// A tile of a cache group to render ahead of time
+struct SpeculativeTile {
+    std::shared_ptr<CacheGroup> group;
+    int tileX;
+    int tileY;
+};
+
+// Function to drop the calling thread to idle priority, so speculative work
+// only runs on otherwise idle cores
+inline void lowerThreadPriority() {
+#if defined(_WIN32)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(__linux__)
+    sched_param param;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+class TileScheduler {
+private:
+    // Everything one in-flight frame needs; two of them alternate
+    struct FrameSlot {
+        FrameKernel kernel;
+        std::vector<int> iterations;
+        std::vector<TileTask> tiles;
+        int width;
+        std::atomic<int> generation;
+        std::atomic<int> nextTile;
+        std::atomic<int> busy;
+
+        // Per-tile claim flags, only used by TileOrder::Focus
+        std::unique_ptr<std::atomic<bool>[]> claimed;
+        TileOrder order;
+
+        // Rendering parameters, to tell whether costs carry over between frames
+        FractalParams params;
+        int maxIterations;
+
+        // Where finished tiles go in the tile cache
+        std::shared_ptr<CacheGroup> cacheGroup;
+
+        // Trace timestamp of the submit, to measure how long tiles queue
+        uint64_t submitTrace;
+
+        FrameSlot()
+            : width(0), generation(-1), nextTile(0), busy(0), order(TileOrder::Fifo), maxIterations(0),
+              submitTrace(0) {}
+    };
+
+    FrameSlot slots[2];
+    CompletionQueue completed;
+    TileOrder order;
+    LaneLayout layout;
+    TileCostMap costs;
+    std::atomic<int> focusX;
+    std::atomic<int> focusY;
+    std::atomic<int> current;
+    std::atomic<bool> running;
+    std::vector<std::thread> workers;
+
+    // Speculation: idle-priority threads and the tiles they work through.
+    // The foreground is idle once idleGeneration catches up with current.
+    std::atomic<TileCache*> cache;
+    std::atomic<int> idleGeneration;
+    std::vector<std::thread> speculators;
+    std::deque<SpeculativeTile> speculative;
+    std::mutex speculativeMutex;
+    std::condition_variable speculativeReady;
+
+    // Only used to park idle workers, never per tile
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    // Set when the consumer has been woken and has not drained since
+    std::function<void()> wake;
+    std::atomic<bool> wakePending;
+
+    void workerLoop(int index) {
+        tracer().nameThread("worker " + std::to_string(index));
+        int finished = -1;
+        while (running.load()) {
+            int generation = current.load();
+            if (generation == finished || generation < 0) {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait(lock, [&] { return !running.load() || current.load() != finished; });
+                continue;
+            }
+
+            FrameSlot& slot = slots[generation & 1];
+            slot.busy.fetch_add(1);
+            if (slot.generation.load() == generation) {
+                renderTiles(slot, generation, index);
+            }
+            slot.busy.fetch_sub(1);
+            finished = generation;
+        }
+    }
+
+    // Function to claim the unclaimed tile nearest to the focus point. The
+    // caller has already reserved a claim through nextTile, so there is
+    // always one left; a lost race with another worker just scans again.
+    int claimNearestFocus(FrameSlot& slot) {
+        const int count = static_cast<int>(slot.tiles.size());
+        for (;;) {
+            int fx = focusX.load(std::memory_order_relaxed);
+            int fy = focusY.load(std::memory_order_relaxed);
+            int best = -1;
+            long long bestDistance = 0;
+            for (int i = 0; i < count; ++i) {
+                if (slot.claimed[i].load(std::memory_order_relaxed)) {
+                    continue;
+                }
+                const TileRect& r = slot.tiles[i].rect;
+                long long dx = (r.x0 + r.x1) / 2 - fx;
+                long long dy = (r.y0 + r.y1) / 2 - fy;
+                long long distance = dx * dx + dy * dy;
+                if (best < 0 || distance < bestDistance) {
+                    best = i;
+                    bestDistance = distance;
+                }
+            }
+            if (best >= 0 && !slot.claimed[best].exchange(true)) {
+                return best;
+            }
+        }
+    }
+
+    void renderTiles(FrameSlot& slot, int generation, int worker) {
+        const int count = static_cast<int>(slot.tiles.size());
+        while (slot.generation.load(std::memory_order_relaxed) == generation) {
+            int index = slot.nextTile.fetch_add(1);
+            if (index >= count) {
+                markIdle(generation);
+                return;
+            }
+            if (slot.order == TileOrder::Focus) {
+                uint64_t scan = tracer().begin();
+                index = claimNearestFocus(slot);
+                tracer().complete("claim", scan, generation, tileId(slot.tiles[index].rect, slot.width));
+            }
+            TileTask& task = slot.tiles[index];
+            const TileRect& r = task.rect;
+            task.stats = LaneStats();
+            task.worker = worker;
+            uint64_t traceStart = tracer().begin();
+            auto start = std::chrono::steady_clock::now();
+            slot.kernel.renderRect(r.x0, r.y0, r.x1, r.y1,
+                                   &slot.iterations[r.y0 * slot.width + r.x0], slot.width, &task.stats);
+            task.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            tracer().complete("tile", traceStart, generation, tileId(r, slot.width), "queued_us",
+                              traceStart > slot.submitTrace ? (traceStart - slot.submitTrace) / 1000 : 0);
+            task.done = true;
+            completed.push(&task.node);
+            if (wake && !wakePending.exchange(true)) {
+                wake();
+            }
+        }
+    }
+
+    // Function to note that every tile of a generation has been claimed and
+    // wake the speculation threads. idleGeneration only moves forward.
+    void markIdle(int generation) {
+        int seen = idleGeneration.load();
+        while (seen < generation && !idleGeneration.compare_exchange_weak(seen, generation)) {
+        }
+        std::lock_guard<std::mutex> lock(speculativeMutex);
+        speculativeReady.notify_all();
+    }
+
+    bool foregroundIdle() const { return idleGeneration.load() >= current.load(); }
+
+    void speculatorLoop(int index) {
+        lowerThreadPriority();
+        tracer().nameThread("speculator " + std::to_string(index));
+        std::vector<int> buffer(TILE_SIZE * TILE_SIZE);
+        while (running.load()) {
+            SpeculativeTile job;
+            {
+                std::unique_lock<std::mutex> lock(speculativeMutex);
+                speculativeReady.wait(lock, [&] {
+                    return !running.load() || (!speculative.empty() && foregroundIdle());
+                });
+                if (!running.load()) {
+                    return;
+                }
+                job = speculative.front();
+                speculative.pop_front();
+            }
+
+            TileCache* target = cache.load();
+            if (target == nullptr || target->contains(*job.group, job.tileX, job.tileY)) {
+                continue;
+            }
+            int x0 = job.tileX * TILE_SIZE;
+            int y0 = job.tileY * TILE_SIZE;
+            uint64_t traceStart = tracer().begin();
+            bool preempted = false;
+            int y = 0;
+            for (; y < TILE_SIZE; y += SPECULATIVE_STRIP_ROWS) {
+                if (!foregroundIdle()) {
+                    preempted = true;
+                    break;
+                }
+                job.group->kernel.renderRect(x0, y0 + y, x0 + TILE_SIZE, y0 + y + SPECULATIVE_STRIP_ROWS,
+                                             &buffer[y * TILE_SIZE], TILE_SIZE, nullptr);
+            }
+            if (preempted) {
+                tracer().complete("speculate (preempted)", traceStart, -1, -1, "rows", y);
+                // Put it back for the next idle period
+                std::lock_guard<std::mutex> lock(speculativeMutex);
+                speculative.push_front(job);
+                continue;
+            }
+            target->insert(*job.group, job.tileX, job.tileY, buffer.data(), TILE_SIZE, true);
+            tracer().complete("speculate", traceStart, -1, -1, "rows", y);
+        }
+    }
+
+public:
+    TileScheduler()
+        : order(TileOrder::LongestFirst), layout(LaneLayout::Refill), focusX(0), focusY(0), current(-1),
+          running(false), cache(nullptr), idleGeneration(-1), wakePending(false) {}
+
+    ~TileScheduler() {
+        stop();
+    }
+
+    void start(int threadCount) {
+        if (threadCount <= 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        running.store(true);
+        for (int t = 0; t < threadCount; ++t) {
+            workers.emplace_back(&TileScheduler::workerLoop, this, t);
+            speculators.emplace_back(&TileScheduler::speculatorLoop, this, t);
+        }
+    }
+
+    void stop() {
+        if (!running.load()) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            running.store(false);
+        }
+        {
+            std::lock_guard<std::mutex> lock(speculativeMutex);
+            speculative.clear();
+        }
+        idle.notify_all();
+        speculativeReady.notify_all();
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].join();
+            speculators[t].join();
+        }
+        workers.clear();
+        speculators.clear();
+    }
+
+    int threadCount() const { return static_cast<int>(workers.size()); }
+
+    // Function to count the workers rendering foreground tiles right now
+    int activeWorkers() const { return slots[0].busy.load() + slots[1].busy.load(); }
+
+    // Function to set what workers call to wake the consumer when a tile is
+    // ready, e.g. posting an event to a UI loop that blocks. It runs on a
+    // worker thread, at most once between two popCompleted() calls. Must be
+    // set before start().
+    void setWakeCallback(const std::function<void()>& callback) { wake = callback; }
+
+    void setOrder(TileOrder tileOrder) { order = tileOrder; }
+    TileOrder getOrder() const { return order; }
+
+    // Lane layout of the float and double kernels of frames submitted next
+    void setLaneLayout(LaneLayout laneLayout) { layout = laneLayout; }
+
+    // Function to attach a tile cache, or detach it with nullptr. Frames
+    // submitted afterwards read from and add to it.
+    void setCache(TileCache* tileCache) { cache.store(tileCache); }
+
+    // Function to replace the speculative work list; tiles are rendered in
+    // order, whenever the foreground has nothing left to claim
+    void speculate(const std::vector<SpeculativeTile>& tiles) {
+        {
+            std::lock_guard<std::mutex> lock(speculativeMutex);
+            speculative.assign(tiles.begin(), tiles.end());
+        }
+        speculativeReady.notify_all();
+    }
+
+    // Function to move the focus point of TileOrder::Focus; any thread, and
+    // it applies to the frame in flight from the next claimed tile on
+    void setFocus(int x, int y) {
+        focusX.store(x, std::memory_order_relaxed);
+        focusY.store(y, std::memory_order_relaxed);
+    }
+
+    // Function to stop the frame in flight: no worker claims another of its
+    // tiles, and its finished tiles are dropped. Returns once no worker is
+    // inside a tile. Must be called from the consumer (UI) thread.
+    void cancel() {
+        for (int i = 0; i < 2; ++i) {
+            slots[i].generation.store(-1);
+        }
+        uint64_t drainStart = tracer().begin();
+        for (int i = 0; i < 2; ++i) {
+            while (slots[i].busy.load() != 0) {
+                std::this_thread::yield();
+            }
+        }
+        tracer().complete("wait for workers", drainStart, current.load());
+        // Nobody is pushing any more, so the queue drains completely
+        while (completed.pop() != nullptr) {
+        }
+    }
+
+    // Function to start rendering a frame; any frame still in flight is
+    // cancelled. Must be called from the consumer (UI) thread. Returns the
+    // generation number that completed tiles of this frame carry.
+    int submit(const Viewport& view, const FractalParams& params, int maxIterations, Precision precision) {
+        int generation = current.load() + 1;
+        FrameSlot& slot = slots[generation & 1];
+        uint64_t traceStart = tracer().begin();
+
+        // Cancel the frame in flight and wait until no worker is inside a tile
+        if (tracer().isEnabled() && generation > 0) {
+            const FrameSlot& cancelled = slots[(generation + 1) & 1];
+            int unclaimed = static_cast<int>(cancelled.tiles.size()) - cancelled.nextTile.load();
+            if (unclaimed > 0) {
+                tracer().instant("cancel", generation - 1, -1, "unclaimed_tiles", unclaimed);
+            }
+        }
+        cancel();
+
+        // Costs measured on the previous frame predict this one, as long as
+        // the same fractal is being rendered; another fractal's costs would
+        // mislead the ordering more than no costs at all
+        const FrameSlot& previous = slots[(generation + 1) & 1];
+        if (generation > 0 && previous.params.formula == params.formula &&
+            previous.params.power == params.power && previous.params.julia == params.julia &&
+            previous.params.juliaReal == params.juliaReal && previous.params.juliaImag == params.juliaImag &&
+            previous.maxIterations == maxIterations) {
+            costs.record(previous.kernel.getViewport(), previous.tiles);
+        } else {
+            costs.clear();
+        }
+
+        slot.kernel.prepare(view, params, maxIterations, precision, layout);
+        slot.params = params;
+        slot.maxIterations = maxIterations;
+        slot.width = view.width;
+        slot.iterations.assign(static_cast<size_t>(view.width) * view.height, 0);
+        slot.tiles = makeTiles(view.width, view.height, generation);
+        if (order == TileOrder::LongestFirst && costs.isValid()) {
+            orderLongestFirst(slot.tiles, costs, view);
+        }
+
+        // Tiles the cache holds are done already; they go first and are
+        // never claimed by a worker
+        TileCache* tileCache = cache.load();
+        int cachedCount = 0;
+        slot.cacheGroup.reset();
+        if (tileCache != nullptr) {
+            Precision chosen = slot.kernel.getPrecision();
+            slot.cacheGroup = tileCache->group(view, params, maxIterations, chosen);
+            for (size_t i = 0; i < slot.tiles.size(); ++i) {
+                TileTask& task = slot.tiles[i];
+                const TileRect& r = task.rect;
+                if (tileCache->lookup(view, params, maxIterations, chosen, r,
+                                      &slot.iterations[r.y0 * view.width + r.x0], view.width, &task.speculated)) {
+                    task.cached = true;
+                    task.done = true;
+                    cachedCount++;
+                }
+            }
+            std::stable_partition(slot.tiles.begin(), slot.tiles.end(),
+                                  [](const TileTask& task) { return task.cached; });
+        }
+
+        slot.order = order;
+        slot.claimed.reset(new std::atomic<bool>[slot.tiles.size()]);
+        for (size_t i = 0; i < slot.tiles.size(); ++i) {
+            slot.claimed[i].store(static_cast<int>(i) < cachedCount, std::memory_order_relaxed);
+            slot.tiles[i].node.task = &slot.tiles[i];
+        }
+        for (int i = 0; i < cachedCount; ++i) {
+            completed.push(&slot.tiles[i].node);
+        }
+        slot.nextTile.store(cachedCount);
+        tracer().complete("submit", traceStart, generation, -1, "cached_tiles", cachedCount);
+        slot.submitTrace = tracer().begin();
+        slot.generation.store(generation);
+
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            current.store(generation);
+        }
+        idle.notify_all();
+        return generation;
+    }
+
+    // Function to take the next finished tile of the current frame, or
+    // nullptr if none is ready. Tiles of cancelled frames are skipped.
+    // Full rendered tiles are added to the tile cache here.
+    const TileTask* popCompleted() {
+        // Cleared before draining, so a tile pushed after the drain wakes again
+        wakePending.store(false);
+        CompletionNode* node;
+        while ((node = completed.pop()) != nullptr) {
+            TileTask* task = node->task;
+            if (task->generation != current.load()) {
+                continue;
+            }
+            FrameSlot& slot = slots[task->generation & 1];
+            TileCache* tileCache = cache.load();
+            const TileRect& r = task->rect;
+            if (tileCache != nullptr && slot.cacheGroup && !task->cached &&
+                r.x1 - r.x0 == TILE_SIZE && r.y1 - r.y0 == TILE_SIZE) {
+                tileCache->insert(*slot.cacheGroup, r.x0 / TILE_SIZE, r.y0 / TILE_SIZE,
+                                  &slot.iterations[r.y0 * slot.width + r.x0], slot.width, false);
+            }
+            return task;
+        }
+        return nullptr;
+    }
+
+    // Iteration counts of a generation, laid out width x height
+    const int* iterations(int generation) const { return slots[generation & 1].iterations.data(); }
+    int tileCount(int generation) const { return static_cast<int>(slots[generation & 1].tiles.size()); }
+    const std::vector<TileTask>& tiles(int generation) const { return slots[generation & 1].tiles; }
+    Precision precision(int generation) const { return slots[generation & 1].kernel.getPrecision(); }
+    std::shared_ptr<CacheGroup> cacheGroup(int generation) const { return slots[generation & 1].cacheGroup; }
+};
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Low-overhead event tracing, exported as Chrome trace JSON (open it in
+// Perfetto or chrome://tracing).
+//
+// Every thread records into its own ring buffer, so recording takes no lock
+// and never contends; the ring keeps the newest TRACE_RING_EVENTS events of
+// its thread. Buffers are allocated on a thread's first event after tracing
+// is enabled. While tracing is disabled every recording call is one relaxed
+// atomic load and a branch, and building with -DMANDEL_NO_TRACE removes
+// even that.
+//
+// Write the trace after disabling tracing: a thread may still finish the one
+// event it was recording, but nothing wraps around under the reader.
+
+#ifdef MANDEL_NO_TRACE
+const bool TRACE_COMPILED = false;
+#else
+const bool TRACE_COMPILED = true;
+#endif
+
+// Events kept per thread (about 56 bytes each)
+const int TRACE_RING_EVENTS = 1 << 15;
+
+struct TraceEvent {
+    const char* name;  // string literal
+    char phase;        // 'X' complete (has a duration), 'i' instant
+    uint64_t start;    // ns since the tracer's origin
+    uint64_t duration; // ns, for 'X'
+    int generation;    // frame the event belongs to, or -1
+    int tile;          // tile index, or -1
+    const char* label; // what value is, e.g. "wait_us", or nullptr
+    int64_t value;
+};
+
+class TraceBuffer {
+public:
+    std::string threadName;
+    int threadId;
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> written; // events ever recorded; the ring holds the newest
+
+    TraceBuffer(int id) : threadId(id), events(new TraceEvent[TRACE_RING_EVENTS]), written(0) {}
+
+    void record(const TraceEvent& event) {
+        uint64_t index = written.load(std::memory_order_relaxed);
+        events[index % TRACE_RING_EVENTS] = event;
+        written.store(index + 1, std::memory_order_release);
+    }
+};
+
+class Tracer {
+private:
+    std::atomic<bool> enabled;
+    std::chrono::steady_clock::time_point origin;
+    std::mutex buffersMutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers; // never shrinks; threads keep raw pointers
+
+    // Name for the calling thread's buffer, set before its first event
+    static std::string& pendingName() {
+        static thread_local std::string name;
+        return name;
+    }
+
+    static TraceBuffer*& threadBuffer() {
+        static thread_local TraceBuffer* buffer = nullptr;
+        return buffer;
+    }
+
+    TraceBuffer* buffer() {
+        TraceBuffer*& local = threadBuffer();
+        if (local == nullptr) {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            buffers.emplace_back(new TraceBuffer(static_cast<int>(buffers.size()) + 1));
+            local = buffers.back().get();
+            local->threadName = pendingName().empty() ? "thread " + std::to_string(local->threadId)
+                                                      : pendingName();
+        }
+        return local;
+    }
+
+    static const char* phaseArgs(const TraceEvent& event) {
+        return event.phase == 'i' ? ",\"s\":\"t\"" : "";
+    }
+
+public:
+    Tracer() : enabled(false), origin(std::chrono::steady_clock::now()) {}
+
+    bool isEnabled() const { return TRACE_COMPILED && enabled.load(std::memory_order_relaxed); }
+
+    // Function to start or stop recording. Starting empties every buffer, so
+    // a capture holds only its own events.
+    void setEnabled(bool on) {
+        if (on && !enabled.load()) {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            for (size_t b = 0; b < buffers.size(); ++b) {
+                buffers[b]->written.store(0, std::memory_order_release);
+            }
+        }
+        enabled.store(on);
+    }
+
+    // Function to name the calling thread in the trace, e.g. "worker 2"
+    void nameThread(const std::string& name) {
+        pendingName() = name;
+        if (threadBuffer() != nullptr) {
+            std::lock_guard<std::mutex> lock(buffersMutex);
+            threadBuffer()->threadName = name;
+        }
+    }
+
+    // Function to get a timestamp for an event, or 0 while disabled
+    uint64_t begin() const {
+        if (!isEnabled()) {
+            return 0;
+        }
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count()) + 1;
+    }
+
+    // Function to record an event that started at start (from begin()) and
+    // ends now. Does nothing if tracing was off when it started.
+    void complete(const char* name, uint64_t start, int generation = -1, int tile = -1,
+                  const char* label = nullptr, int64_t value = 0) {
+        if (start == 0 || !isEnabled()) {
+            return;
+        }
+        uint64_t end = begin();
+        TraceEvent event = { name, 'X', start, end > start ? end - start : 0, generation, tile, label, value };
+        buffer()->record(event);
+    }
+
+    // Function to record a point in time
+    void instant(const char* name, int generation = -1, int tile = -1,
+                 const char* label = nullptr, int64_t value = 0) {
+        uint64_t now = begin();
+        if (now == 0) {
+            return;
+        }
+        TraceEvent event = { name, 'i', now, 0, generation, tile, label, value };
+        buffer()->record(event);
+    }
+
+    // Function to write every buffered event as Chrome trace JSON
+    bool write(const char* path) {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (size_t b = 0; b < buffers.size(); ++b) {
+            const TraceBuffer& buffer = *buffers[b];
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                               "\"args\":{\"name\":\"%s\"}}",
+                         first ? "" : ",\n", buffer.threadId, buffer.threadName.c_str());
+            first = false;
+
+            uint64_t written = buffer.written.load(std::memory_order_acquire);
+            uint64_t oldest = written > static_cast<uint64_t>(TRACE_RING_EVENTS) ? written - TRACE_RING_EVENTS : 0;
+            for (uint64_t i = oldest; i < written; ++i) {
+                const TraceEvent& event = buffer.events[i % TRACE_RING_EVENTS];
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                             event.name, event.phase, buffer.threadId, event.start / 1000.0);
+                if (event.phase == 'X') {
+                    std::fprintf(file, ",\"dur\":%.3f", event.duration / 1000.0);
+                }
+                std::fprintf(file, "%s,\"args\":{\"generation\":%d,\"tile\":%d", phaseArgs(event),
+                             event.generation, event.tile);
+                if (event.label != nullptr) {
+                    std::fprintf(file, ",\"%s\":%lld", event.label, static_cast<long long>(event.value));
+                }
+                std::fprintf(file, "}}");
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+    // Function to get the events recorded so far, across all threads
+    uint64_t eventCount() {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        uint64_t total = 0;
+        for (size_t b = 0; b < buffers.size(); ++b) {
+            uint64_t written = buffers[b]->written.load(std::memory_order_acquire);
+            total += std::min<uint64_t>(written, TRACE_RING_EVENTS);
+        }
+        return total;
+    }
+};
+
+// The process-wide tracer
+inline Tracer& tracer() {
+    static Tracer instance;
+    return instance;
+}
+
+#endif